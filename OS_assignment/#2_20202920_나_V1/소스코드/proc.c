@@ -8,82 +8,659 @@
 #include "spinlock.h"
 
 //프로세스들을 관리하기 위한 프로세스 테이블이다.
+//lock은 슬롯 할당과 해제, 부모/자식 리스트, pid 해시만 보호한다.
+//프로세스의 상태와 문맥 전환은 프로세스마다 있는 plock으로, 대기 버킷은 버킷마다 있는 sleeplock으로 보호하기 때문에
+//문맥 전환, sleep, wakeup은 모든 cpu가 하나의 락을 두고 경쟁하지 않는다.
 struct {
   struct spinlock lock;//lock은 다중 프로세스 시스템에서 프로세스 테이블에 대한 동시접근을 제어하기 위한 잠금 메커니즘이다.
   struct proc proc[NPROC]; //NPROC은 64로 최대로 가능한 프로세스 개수는 64개이다.
-  struct proc *mlfq[NUM_QUEUES];  // 4개의 큐 레벨을 위한 배열
+  struct spinlock plock[NPROC]; //proc[i]의 state와 문맥 전환을 보호하는 락
+  struct proc *sleepq[1 << SLEEPQ_BITS]; //잠든 프로세스를 chan의 해시 값에 따라 나눠 담은 버킷, wakeup은 해당 버킷만 본다.
+  struct spinlock sleeplock[1 << SLEEPQ_BITS]; //sleepq[i] 버킷을 보호하는 락
+  struct proc *freeslot[NPROC]; //UNUSED 슬롯을 쌓아둔 스택, allocproc은 맨 위의 것을 바로 꺼낸다.
+  int nfree;                    //freeslot 스택에 들어있는 슬롯 수
+  struct proc *pidhash[NPROC];  //pid로 프로세스를 찾기 위한 해시, pid는 차례로 늘어나므로 pid % NPROC으로 고르게 나뉜다.
 } ptable;
 
+//cpu마다 하나씩 있는 MLFQ 런큐다.
+//큐는 각자의 락으로 보호되기 때문에 런큐를 조작할 때 다른 cpu와 ptable.lock을 두고 경쟁하지 않는다.
+//락 순서는 ptable.lock -> 대기 버킷 락 -> 프로세스 락 -> runq.lock 이고, 런큐 두 개를 잡을 때는 cpu 번호가 작은 쪽을 먼저 잡는다.
+struct runq {
+  struct spinlock lock;
+  struct proc *mlfq[NUM_QUEUES][NPROC]; // 레벨별 이진 힙, RUNNABLE 상태인 프로세스만 들어간다. [0]이 다음에 실행될 프로세스다.
+  int mlfq_size[NUM_QUEUES];      // 레벨별 힙에 들어있는 프로세스 수
+  uint mlfq_bitmap;               // i번째 비트가 1이면 mlfq[i]가 비어있지 않다는 뜻이다.
+  int nrunnable;                  // 런큐에 들어있는 프로세스 수, 부하 분산의 기준이 된다.
+  uint balance_tick;              // 마지막으로 부하 분산을 한 tick
+  struct proc *aging_wheel[AGING_WHEEL]; // aging이 일어날 tick별로 프로세스를 모아둔 타이머 휠
+  uint wheel_tick;                // 타이머 휠을 어디까지 처리했는지 나타내는 tick
+};
+
+struct runq runqs[NCPU];
+
+//큐 레벨별 할당 시간(tick)이다. 부팅할 때 MLFQ_QUANTA로 채우고, set_mlfq_quantum 시스템 콜로 바꿀 수 있다.
+int mlfq_quantum[NUM_QUEUES];
+
 static struct proc *initproc;
 
+//Local APIC ID로 cpu를 바로 찾기 위한 역방향 표다. APIC ID는 uchar라서 256칸이면 충분하다.
+//seginit이 pinit보다 먼저 mycpu를 부르므로 미리 채워둘 수 없고, 처음 찾을 때 cpus[]를 훑어서 채운다.
+static struct cpu *apicid_cpu[256];
+
+
+//비트맵에서 가장 낮은 레벨(우선순위가 가장 높은 큐)을 찾는다.
+//bsf 명령어 한 번으로 찾기 때문에 큐 개수와 상관없이 상수 시간이다.
+//비트맵이 0이 아닐 때만 호출해야 한다.
+static inline int
+mlfq_first_level(uint bitmap)
+{
+  uint level;
+
+  asm volatile("bsfl %1, %0" : "=r" (level) : "rm" (bitmap));
+  return level;
+}
+
+//비트맵에서 가장 높은 레벨(우선순위가 가장 낮은 큐)을 찾는다. 다른 cpu의 일을 가져올 때 쓴다.
+static inline int
+mlfq_last_level(uint bitmap)
+{
+  uint level;
+
+  asm volatile("bsrl %1, %0" : "=r" (level) : "rm" (bitmap));
+  return level;
+}
+
+//스케줄러가 고르는 순서와 같은 기준으로 a가 b보다 먼저 실행되어야 하는지 판단한다.
+//io_wait_time이 큰 것, 같으면 cpu_wait이 작은 것, 그것도 같으면 pid가 큰 것을 먼저 선택한다.
+//런큐에 있는 동안 cpu_wait은 ticks - wait_origin이므로 wait_origin이 늦을수록 cpu_wait이 작다.
+//tick이 지나도 wait_origin은 그대로라 힙의 순서는 깨지지 않는다.
+static int
+mlfq_before(struct proc *a, struct proc *b)
+{
+  if(a->io_wait_time != b->io_wait_time)
+    return a->io_wait_time > b->io_wait_time;
+  if(a->wait_origin != b->wait_origin)
+    return (int)(a->wait_origin - b->wait_origin) > 0;
+  return a->pid > b->pid;
+}
+
+//aging 대상이면 aging이 일어날 tick에 해당하는 타이머 휠 칸에 넣는다.
+//shell idle init은 aging하지 않고, 0번 큐는 더 올라갈 곳이 없다.
+static void
+wheel_insert(struct runq *rq, struct proc *p)
+{
+  struct proc **slot;
+
+  if(p->pid <= 2 || p->q_level == 0)
+    return;
+  p->aging_deadline = p->wait_origin + AGING_TICKS;
+  //set_proc_info로 cpu_wait이 이미 넘친 경우에는 다음 tick에 바로 올라가게 한다.
+  if((int)(p->aging_deadline - rq->wheel_tick) <= 0)
+    p->aging_deadline = rq->wheel_tick + 1;
+
+  slot = &rq->aging_wheel[p->aging_deadline % AGING_WHEEL];
+  p->aging_prev = 0;
+  p->aging_next = *slot;
+  if(*slot)
+    (*slot)->aging_prev = p;
+  *slot = p;
+  p->on_wheel = 1;
+}
+
+//타이머 휠에서 떼어낸다.
+static void
+wheel_delete(struct runq *rq, struct proc *p)
+{
+  if(!p->on_wheel)
+    return;
+  if(p->aging_prev)
+    p->aging_prev->aging_next = p->aging_next;
+  else
+    rq->aging_wheel[p->aging_deadline % AGING_WHEEL] = p->aging_next;
+  if(p->aging_next)
+    p->aging_next->aging_prev = p->aging_prev;
+  p->aging_next = 0;
+  p->aging_prev = 0;
+  p->on_wheel = 0;
+}
+
+//힙의 i번째 자리에 p를 놓고 p가 기억하는 인덱스도 같이 바꾼다.
+static inline void
+heap_set(struct proc **heap, int i, struct proc *p)
+{
+  heap[i] = p;
+  p->heap_idx = i;
+}
+
+//i번째 프로세스를 부모보다 우선순위가 낮아질 때까지 위로 올린다.
+static void
+heap_sift_up(struct proc **heap, int i)
+{
+  struct proc *p = heap[i];
+  int parent;
+
+  while(i > 0){
+    parent = (i - 1) / 2;
+    if(!mlfq_before(p, heap[parent]))
+      break;
+    heap_set(heap, i, heap[parent]);
+    i = parent;
+  }
+  heap_set(heap, i, p);
+}
+
+//i번째 프로세스를 자식들보다 우선순위가 높아질 때까지 아래로 내린다.
+static void
+heap_sift_down(struct proc **heap, int n, int i)
+{
+  struct proc *p = heap[i];
+  int child;
+
+  while((child = 2 * i + 1) < n){
+    if(child + 1 < n && mlfq_before(heap[child + 1], heap[child]))
+      child++;
+    if(!mlfq_before(heap[child], p))
+      break;
+    heap_set(heap, i, heap[child]);
+    i = child;
+  }
+  heap_set(heap, i, p);
+}
+
+//rq의 q_level 힙에 넣는다. O(log n)이다.
+//rq->lock을 잡은 상태에서 호출해야 한다.
+static void
+mlfq_insert(struct runq *rq, struct proc *p, int q_level)
+{
+  int n;
+
+  p->q_level = q_level;
+  if(p->on_mlfq)
+    panic("add_proc_to_mlfq");
+
+  n = rq->mlfq_size[q_level]++;
+  heap_set(rq->mlfq[q_level], n, p);
+  heap_sift_up(rq->mlfq[q_level], n);
+
+  p->on_mlfq = 1;
+  rq->mlfq_bitmap |= 1 << q_level;
+  rq->nrunnable++;
+  wheel_insert(rq, p);
+}
+
+//rq에서 p를 떼어낸다. p가 힙에서의 위치를 기억하고 있기 때문에 탐색 없이 O(log n)에 뺄 수 있다.
+//rq->lock을 잡은 상태에서 호출해야 한다.
+static void
+mlfq_delete(struct runq *rq, struct proc *p)
+{
+  struct proc **heap = rq->mlfq[p->q_level];
+  int i = p->heap_idx;
+  int n;
+
+  n = --rq->mlfq_size[p->q_level];
+  if(i != n){
+    //마지막 원소를 빈자리로 옮기고, 위나 아래 중 맞는 방향으로 자리를 찾아준다.
+    heap_set(heap, i, heap[n]);
+    if(i > 0 && mlfq_before(heap[i], heap[(i - 1) / 2]))
+      heap_sift_up(heap, i);
+    else
+      heap_sift_down(heap, n, i);
+  }
+  heap[n] = 0;
+  wheel_delete(rq, p);
+
+  p->heap_idx = -1;
+  p->on_mlfq = 0;
+  if(n == 0)
+    rq->mlfq_bitmap &= ~(1 << p->q_level);
+  rq->nrunnable--;
+}
+
+//p가 들어갈 런큐의 락을 잡는다.
+//락을 기다리는 사이에 다른 cpu가 p를 가져갔을 수 있기 때문에 잡은 뒤에 한 번 더 확인한다.
+static struct runq*
+lock_proc_runq(struct proc *p)
+{
+  struct runq *rq;
+
+  for(;;){
+    rq = &runqs[p->rq_cpu];
+    acquire(&rq->lock);
+    if(rq == &runqs[p->rq_cpu])
+      return rq;
+    release(&rq->lock);
+  }
+}
 
 //레벨을 입력하여 mlfq에 추가해주는 함수
-//새로 들어온 큐가 앞에 위치할 수 있게끔 설정
+//RUNNABLE 상태가 될 때만 호출되며, p->rq_cpu의 런큐에 헤더가 항상 다음에 실행될 프로세스가 되도록 정렬해서 넣는다.
 void add_proc_to_mlfq(struct proc *p, int q_level) {
+  struct runq *rq;
+
+  rq = lock_proc_runq(p);
+  mlfq_insert(rq, p, q_level);
+  release(&rq->lock);
+}
+
+//mlfq에서 제거해주는 형태다.
+//런큐에 없으면 아무것도 하지 않는다.
+void remove_proc_from_mlfq(struct proc *p) {
+  struct runq *rq;
+
+  rq = lock_proc_runq(p);
+  if(p->on_mlfq)
+    mlfq_delete(rq, p);
+  release(&rq->lock);
+}
+
+//레벨과 정렬 기준이 되는 값들을 한 번에 바꾼다.
+//지금 상태에서 늘어나고 있는 값은 기준 tick도 같이 옮겨서 다음 tick부터 이어서 세어지게 한다.
+//런큐에 있는 경우에는 힙에서 꺼냈다가 바뀐 값으로 다시 넣어 O(log n)에 자리를 맞춘다.
+void update_proc_in_mlfq(struct proc *p, int q_level, int cpu_burst, int cpu_wait, int io_wait_time) {
+  struct runq *rq;
+  int queued;
+
+  rq = lock_proc_runq(p);
+  queued = p->on_mlfq;
+  if(queued)
+    mlfq_delete(rq, p);
   p->q_level = q_level;
-  p->next = 0;
+  p->cpu_burst = cpu_burst;
+  p->cpu_wait = cpu_wait;
+  p->io_wait_time = io_wait_time;
+  p->run_origin = ticks - cpu_burst;
+  p->wait_origin = ticks - cpu_wait;
+  p->sleep_origin = ticks - io_wait_time;
+  if(queued)
+    mlfq_insert(rq, p, p->q_level);
+  release(&rq->lock);
+}
 
-  // 리스트가 비어있는 경우
-  if (ptable.mlfq[q_level] == 0) {
-    ptable.mlfq[q_level] = p;
+//타이머 인터럽트마다 각 cpu가 자기 런큐의 타이머 휠에서 aging 시각이 된 프로세스만 한 단계 위의 큐로 올린다.
+//대기 시간은 기준 tick으로부터 계산하기 때문에 매 tick마다 프로세스를 훑으며 값을 올릴 필요가 없고,
+//처리할 칸이 없으면 락도 잡지 않는다.
+void mlfq_tick(void) {
+  struct runq *rq = &runqs[cpuid()];
+  struct proc *p, *next;
+  uint t;
+
+  if(rq->wheel_tick == ticks)
     return;
+
+  acquire(&rq->lock);
+  //오래 밀려 있었다면 휠 한 바퀴만 돌면 모든 칸을 한 번씩 보게 된다.
+  if(ticks - rq->wheel_tick > AGING_WHEEL)
+    rq->wheel_tick = ticks - AGING_WHEEL;
+  while(rq->wheel_tick != ticks){
+    t = ++rq->wheel_tick;
+    for(p = rq->aging_wheel[t % AGING_WHEEL]; p != 0; p = next){
+      next = p->aging_next;
+      if((int)(p->aging_deadline - t) > 0)
+        continue;
+      #ifdef DEBUG
+        if(p->pid > 3){
+        cprintf("PID: %d Aging\n",p->pid);
+        }
+      #endif
+      mlfq_delete(rq, p);
+      p->io_wait_time = 0;
+      p->cpu_burst = 0;
+      p->cpu_wait = 0;
+      p->wait_origin = ticks;
+      mlfq_insert(rq, p, p->q_level - 1);
+    }
   }
+  release(&rq->lock);
+}
+
+//다음에 실행할 프로세스를 런큐에서 꺼낸다.
+//비어있지 않은 가장 높은 우선순위의 레벨을 찾고, 그 레벨 힙의 루트를 꺼내면 된다.
+//비어있으면 락을 잡지 않고 바로 돌아간다.
+static struct proc*
+pick_proc_from_mlfq(struct runq *rq)
+{
+  struct proc *p;
 
-  // 현재 큐의 헤더를 가져옴
-  struct proc *curr = ptable.mlfq[q_level];
-  struct proc *prev = 0;
+  if(rq->mlfq_bitmap == 0)
+    return 0;
+  acquire(&rq->lock);
+  p = 0;
+  if(rq->mlfq_bitmap != 0){
+    p = rq->mlfq[mlfq_first_level(rq->mlfq_bitmap)][0];
+    mlfq_delete(rq, p);
+  }
+  release(&rq->lock);
+  return p;
+}
 
-  // `io_wait_time` 기준으로 위치를 찾음
-  while (curr != 0 && (curr->io_wait_time > p->io_wait_time || 
-                       (curr->io_wait_time == p->io_wait_time))) {
-    prev = curr;
-    curr = curr->next;
+//가장 많은 프로세스가 기다리고 있는 cpu를 찾는다. 없으면 -1을 반환한다.
+//락 없이 개수만 읽기 때문에 대략적인 값이고, 실제로 옮길 때 다시 확인한다.
+static int
+busiest_cpu(int self)
+{
+  int i, busiest, most;
+
+  busiest = -1;
+  most = 0;
+  for(i = 0; i < ncpu; i++){
+    if(i != self && runqs[i].nrunnable > most){
+      most = runqs[i].nrunnable;
+      busiest = i;
+    }
   }
+  return busiest;
+}
 
-  // 맨 앞에 삽입하는 경우 (헤더 변경)
-  if (prev == 0) {
-    p->next = ptable.mlfq[q_level];
-    ptable.mlfq[q_level] = p;
+//from cpu의 가장 낮은 우선순위 큐에서 프로세스 하나를 to cpu의 런큐로 옮긴다.
+//from 런큐에 to보다 diff개 이상 더 많이 기다리고 있을 때만 옮긴다.
+static void
+migrate_proc(int from, int to, int diff)
+{
+  struct runq *src = &runqs[from];
+  struct runq *dst = &runqs[to];
+  struct proc *p;
+
+  if(from < to){
+    acquire(&src->lock);
+    acquire(&dst->lock);
   } else {
-    // 중간 또는 끝에 삽입하는 경우
-    prev->next = p;
-    p->next = curr;
+    acquire(&dst->lock);
+    acquire(&src->lock);
   }
+  if(src->mlfq_bitmap != 0 && src->nrunnable - dst->nrunnable >= diff){
+    p = src->mlfq[mlfq_last_level(src->mlfq_bitmap)][0];
+    mlfq_delete(src, p);
+    p->rq_cpu = to;
+    mlfq_insert(dst, p, p->q_level);
+  }
+  release(&src->lock);
+  release(&dst->lock);
 }
 
-//mlfq에서 제거해주는 형태다.
-void remove_proc_from_mlfq(struct proc *p) {
-  int q_level = p->q_level;
-  struct proc *curr = ptable.mlfq[q_level];
-  struct proc *prev = 0;
-
-  while (curr != 0) {
-    if (curr == p) {
-      if (prev == 0) {
-        // 삭제할 프로세스가 헤더인 경우
-        ptable.mlfq[q_level] = curr->next;
-      } else {
-        // 중간 또는 마지막 프로세스인 경우
-        prev->next = curr->next;
-      }
+//idle 상태인 cpu는 가장 바쁜 cpu에서 일을 가져오고,
+//BALANCE_TICKS마다 한 번씩은 런큐 길이 차이가 2 이상 나면 하나를 가져와서 런큐들을 고르게 맞춘다.
+//idle cpu가 매 루프마다 다른 cpu의 런큐 락을 잡으면 그 cpu의 스케줄링을 방해하므로 가져오기는 tick마다 한 번만 해 본다.
+static void
+balance_runqs(int self)
+{
+  struct runq *rq = &runqs[self];
+  int busiest;
+
+  if(rq->mlfq_bitmap == 0){
+    if(rq->balance_tick == ticks)
+      return;
+    rq->balance_tick = ticks;
+  } else if(ticks - rq->balance_tick < BALANCE_TICKS)
+    return;
+  if((busiest = busiest_cpu(self)) < 0)
+    return;
+  if(rq->mlfq_bitmap == 0){
+    migrate_proc(busiest, self, 1);
+  } else {
+    rq->balance_tick = ticks;
+    migrate_proc(busiest, self, 2);
+  }
+}
+
+//프로세스를 만들 때 가장 한가한 cpu의 런큐를 골라준다.
+static int
+idlest_cpu(void)
+{
+  int i, idlest;
+
+  idlest = 0;
+  for(i = 1; i < ncpu; i++)
+    if(runqs[i].nrunnable < runqs[idlest].nrunnable)
+      idlest = i;
+  return idlest;
+}
+
+//cpu를 내려놓는 프로세스의 레벨을 조정한다. 3이 아니라면 내려 주어야 한다.
+//런큐가 cpu마다 나뉘어 있어서 다른 cpu가 바로 가져갈 수 있으므로, 스케줄러로 돌아간 뒤가 아니라
+//런큐에 다시 들어가거나 잠들기 전에 해야 한다.
+static void
+mlfq_demote(struct proc *p)
+{
+  if(p->q_level != 3){
+    p->q_level++;
+    p->cpu_burst = 0;
+    p->cpu_wait = 0;
+    p->io_wait_time = 0;
+  }else{
+    //3번큐 cpu_wait는 없애야 한다.
+    p->cpu_wait = 0;
+    p->cpu_burst = 0;
+  }
+}
+
+//p의 state와 문맥 전환을 보호하는 락을 반환한다.
+static inline struct spinlock*
+proclock(struct proc *p)
+{
+  return &ptable.plock[p - ptable.proc];
+}
+
+//chan이 들어갈 대기 버킷의 번호를 고른다.
+//chan은 주로 구조체의 주소라서 아래 비트들이 정렬 때문에 비슷하므로 곱셈 해시로 위쪽 비트를 쓴다.
+static inline uint
+sleepq_hash(void *chan)
+{
+  return ((uint)chan * 2654435761u) >> (32 - SLEEPQ_BITS);
+}
+
+static inline struct proc**
+sleepq_bucket(void *chan)
+{
+  return &ptable.sleepq[sleepq_hash(chan)];
+}
+
+//chan의 버킷을 보호하는 락을 반환한다.
+static inline struct spinlock*
+sleepq_lock(void *chan)
+{
+  return &ptable.sleeplock[sleepq_hash(chan)];
+}
+
+//잠드는 프로세스를 chan의 버킷 맨 앞에 넣는다. chan의 버킷 락을 잡은 상태에서 호출해야 한다.
+static void
+sleepq_insert(struct proc *p)
+{
+  struct proc **bucket = sleepq_bucket(p->chan);
+
+  p->sleep_prev = 0;
+  p->sleep_next = *bucket;
+  if(*bucket)
+    (*bucket)->sleep_prev = p;
+  *bucket = p;
+}
+
+//깨어나는 프로세스를 버킷에서 떼어낸다. chan의 버킷 락을 잡은 상태에서 호출해야 한다.
+static void
+sleepq_delete(struct proc *p)
+{
+  if(p->sleep_prev)
+    p->sleep_prev->sleep_next = p->sleep_next;
+  else
+    *sleepq_bucket(p->chan) = p->sleep_next;
+  if(p->sleep_next)
+    p->sleep_next->sleep_prev = p->sleep_prev;
+  p->sleep_next = 0;
+  p->sleep_prev = 0;
+}
+
+//프로세스를 RUNNABLE로 바꾸고 현재 레벨의 런큐에 넣는다.
+//잠들어 있었다면 대기 버킷에서 빼고 잠든 시간을 io_wait_time에 더하고, 지금부터 cpu_wait이 늘어나도록 기준 tick을 잡는다.
+//p의 락을 잡은 상태에서 호출해야 하고, 잠들어 있었다면 chan의 버킷 락도 잡고 있어야 한다.
+static void
+make_runnable(struct proc *p)
+{
+  if(p->state == SLEEPING){
+    sleepq_delete(p);
+    p->io_wait_time = ticks - p->sleep_origin;
+  }
+  p->state = RUNNABLE;
+  p->wait_origin = ticks - p->cpu_wait;
+  add_proc_to_mlfq(p, p->q_level);
+}
+
+
+//부모가 가진 자식 리스트(children 또는 zombies)의 맨 앞에 p를 넣는다.
+//ptable.lock을 잡은 상태에서 호출해야 한다.
+static void
+child_link(struct proc **list, struct proc *p)
+{
+  p->sibling_prev = 0;
+  p->sibling_next = *list;
+  if(*list)
+    (*list)->sibling_prev = p;
+  *list = p;
+}
+
+//자식 리스트에서 p를 떼어낸다. 이중 연결 리스트라서 탐색이 필요 없다.
+//ptable.lock을 잡은 상태에서 호출해야 한다.
+static void
+child_unlink(struct proc **list, struct proc *p)
+{
+  if(p->sibling_prev)
+    p->sibling_prev->sibling_next = p->sibling_next;
+  else
+    *list = p->sibling_next;
+  if(p->sibling_next)
+    p->sibling_next->sibling_prev = p->sibling_prev;
+  p->sibling_next = 0;
+  p->sibling_prev = 0;
+}
+
+//src 리스트의 자식들을 모두 parent의 자식으로 바꾸고 dst 리스트 앞에 통째로 이어 붙인다.
+//부모 포인터를 바꾸기 위해 src만 한 번 훑으면 되고, 옮긴 자식 수를 반환한다.
+//ptable.lock을 잡은 상태에서 호출해야 한다.
+static int
+child_splice(struct proc **dst, struct proc **src, struct proc *parent)
+{
+  struct proc *p, *tail;
+  int n;
+
+  if(*src == 0)
+    return 0;
+  n = 0;
+  tail = 0;
+  for(p = *src; p != 0; p = p->sibling_next){
+    p->parent = parent;
+    tail = p;
+    n++;
+  }
+  tail->sibling_next = *dst;
+  if(*dst)
+    (*dst)->sibling_prev = tail;
+  *dst = *src;
+  *src = 0;
+  return n;
+}
+
+//p를 pid 해시에 넣는다. ptable.lock을 잡은 상태에서 호출해야 한다.
+static void
+pidhash_insert(struct proc *p)
+{
+  struct proc **bucket = &ptable.pidhash[p->pid % NPROC];
+
+  p->pid_next = *bucket;
+  *bucket = p;
+}
+
+//p를 pid 해시에서 뺀다. 한 버킷에는 보통 하나만 있으므로 버킷 안에서만 찾으면 된다.
+//ptable.lock을 잡은 상태에서 호출해야 한다.
+static void
+pidhash_delete(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &ptable.pidhash[p->pid % NPROC]; *pp != 0; pp = &(*pp)->pid_next){
+    if(*pp == p){
+      *pp = p->pid_next;
+      p->pid_next = 0;
       return;
     }
-    prev = curr;
-    curr = curr->next;
   }
+  panic("pidhash_delete");
+}
+
+//pid에 해당하는 프로세스를 테이블을 훑지 않고 찾는다. 없으면 0을 반환한다.
+//ptable.lock을 잡은 상태에서 호출해야 한다.
+struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  for(p = ptable.pidhash[pid % NPROC]; p != 0; p = p->pid_next)
+    if(p->pid == pid)
+      return p;
+  return 0;
 }
 
+//다 쓴 슬롯을 UNUSED로 돌려놓고 pid 해시에서 빼서 freeslot 스택에 쌓는다.
+//ptable.lock을 잡은 상태에서 호출해야 한다.
+static void
+free_proc_slot(struct proc *p)
+{
+  pidhash_delete(p);
+  p->pid = 0;
+  p->state = UNUSED;
+  ptable.freeslot[ptable.nfree++] = p;
+}
 
 int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
-static void wakeup1(void *chan);
-
 void
 pinit(void)
 {
+  int i;
+
+  static int quanta[NUM_QUEUES] = MLFQ_QUANTA;
+
   initlock(&ptable.lock, "ptable");
+  for(i = 0; i < NPROC; i++)
+    initlock(&ptable.plock[i], "proc");
+  for(i = 0; i < (1 << SLEEPQ_BITS); i++)
+    initlock(&ptable.sleeplock[i], "sleepq");
+  for(i = 0; i < NCPU; i++)
+    initlock(&runqs[i].lock, "runq");
+  for(i = 0; i < NUM_QUEUES; i++)
+    mlfq_quantum[i] = quanta[i];
+  //처음에는 모든 슬롯이 비어 있다. proc[0]부터 꺼내지도록 거꾸로 쌓는다.
+  for(i = NPROC - 1; i >= 0; i--)
+    ptable.freeslot[ptable.nfree++] = &ptable.proc[i];
+}
+
+//실행을 시작하는 프로세스가 cpu를 내려놓아야 할 tick을 미리 계산한다.
+//레벨의 할당 시간이 끝나는 tick과 end_time까지 남은 시간을 다 쓰는 tick 중 먼저 오는 것이 slice_end가 되고,
+//end_time 쪽이 먼저 오거나 같으면 그때 yield 대신 종료한다.
+//p의 락을 잡은 상태이거나, p가 자기 자신에 대해 인터럽트를 막은 상태에서 호출해야 한다.
+void
+mlfq_set_slice(struct proc *p)
+{
+  int quantum = mlfq_quantum[p->q_level];
+  int remaining = p->end_time - p->stack_cpu_burst;
+
+  p->slice_exit = (p->end_time > 0 && remaining <= quantum);
+  if(p->slice_exit)
+    p->slice_end = p->run_origin + remaining;
+  else
+    p->slice_end = p->run_origin + quantum;
+}
+
+//level의 할당 시간을 quantum tick으로 바꾸고 이전 값을 반환한다.
+//이미 실행 중인 프로세스는 다음에 실행될 때부터 바뀐 값이 적용된다.
+//스케줄러는 락 없이 값을 읽으므로 xchg로 한 번에 바꾸면서 이전 값을 얻는다.
+int
+set_mlfq_quantum(int level, int quantum)
+{
+  if(level < 0 || level >= NUM_QUEUES || quantum <= 0)
+    return -1;
+  return xchg((volatile uint*)&mlfq_quantum[level], quantum);
 }
 
 // Must be called with interrupts disabled
@@ -94,35 +671,45 @@ cpuid() {
 
 
 //현재 실행중인 cpu를 반환하는 함수다.
+//APIC ID가 연속적이지 않을 수 있어서 cpus[]를 훑는 대신 역방향 표로 바로 찾는다.
+//표가 비어있으면(그 cpu에서 처음 부른 경우) 예전처럼 cpus[]를 훑어서 찾고 표에 적어둔다.
 struct cpu*
 mycpu(void)
 {
+  struct cpu *c;
   int apicid, i;
   
   if(readeflags()&FL_IF)
     panic("mycpu called with interrupts enabled\n");
   
   apicid = lapicid();
-  // APIC IDs are not guaranteed to be contiguous. Maybe we should have
-  // a reverse map, or reserve a register to store &cpus[i].
+  if((c = apicid_cpu[apicid]) != 0)
+    return c;
   for (i = 0; i < ncpu; ++i) {
-    if (cpus[i].apicid == apicid)
+    if (cpus[i].apicid == apicid){
+      apicid_cpu[apicid] = &cpus[i];
       return &cpus[i];
+    }
   }
   panic("unknown apicid\n");
 }
 
-// Disable interrupts so that we are not rescheduled
-// while reading proc from the cpu structure
+//현재 프로세스를 반환하는 함수다.
+//커널 스택은 페이지 하나(KSTACKSIZE == PGSIZE)이고 allocproc이 맨 아래 칸에 주인 프로세스를 적어두므로,
+//esp를 페이지 경계로 내려서 읽기만 하면 된다. 한 번 읽고 끝나서 도중에 다른 cpu로 옮겨가도 값이 틀리지 않으므로
+//pushcli/popcli와 lapic 레지스터 읽기가 필요 없다.
+//스케줄러 스택처럼 프로세스의 커널 스택이 아니면 그 칸이 가리키는 프로세스의 kstack과 맞지 않으므로 0을 반환한다.
 struct proc*
 myproc(void) {
-  struct cpu *c;
   struct proc *p;
-  //현재 cpu의 인터럽트를 비활성화하고 동시에 이전상태를 저장하여 나중에 복원할 수 있게 한다.
-  pushcli();
-  c = mycpu();
-  p = c->proc;
-  popcli();
+  char *kstack;
+  uint esp;
+
+  asm volatile("movl %%esp, %0" : "=r" (esp));
+  kstack = (char*)PGROUNDDOWN(esp);
+  p = *(struct proc**)kstack;
+  if(p < ptable.proc || p >= &ptable.proc[NPROC] || p->kstack != kstack)
+    return 0;
   return p;
 }
 
@@ -137,17 +724,16 @@ allocproc(void)
 
   acquire(&ptable.lock);
   
-  //이미 만들어진 슬롯에 UNUSED로 사용되지 않고 있는 곳이 있는지 판단하여 넣어주는 것이다.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock); //다시 ptable에 대한 락을 해제한다.
-  return 0; //0이 반환되면 실패한 것이고 더 이상 프로세스에 넣을 공간이없다는 뜻이다.
+  //UNUSED 슬롯은 freeslot 스택에 모여 있으므로 테이블을 훑지 않고 맨 위의 것을 꺼낸다.
+  if(ptable.nfree == 0){
+    release(&ptable.lock); //다시 ptable에 대한 락을 해제한다.
+    return 0; //0이 반환되면 실패한 것이고 더 이상 프로세스에 넣을 공간이없다는 뜻이다.
+  }
+  p = ptable.freeslot[--ptable.nfree];
 
-found:
   p->state = EMBRYO; //EMBRYO는 프로세스가 생성 중인 상태를 의미한다.
   p->pid = nextpid++; //pid를 설정해주는 것이다.
+  pidhash_insert(p); //kill 같은 pid로 찾는 시스템 콜이 해시로 바로 찾을 수 있게 한다.
 
   // 추가: MLFQ 관련 변수 초기화
   p->q_level = 0;          // 최상위 큐에서 시작
@@ -156,15 +742,26 @@ found:
   p->io_wait_time = 0;     // I/O 대기 시간 초기화
   p->end_time = -1;         // cpu 총 사용할당량 초기화
   p->stack_cpu_burst = 0;
+  p->heap_idx = -1;
+  p->on_mlfq = 0;
+  p->rq_cpu = 0;
+  p->on_wheel = 0;
+  p->children = 0;
+  p->zombies = 0;
+  p->nzombie = 0;
 
 
   release(&ptable.lock);
 
   //커널 스택 -> 커널 모드에서 사용할 수 있는 함수 호출 스택을 의미한다.
   if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+    acquire(&ptable.lock);
+    free_proc_slot(p);
+    release(&ptable.lock);
     return 0;
   }
+  //myproc이 esp만 보고 찾을 수 있도록 스택 맨 아래에 주인을 적어둔다.
+  *(struct proc**)p->kstack = p;
   sp = p->kstack + KSTACKSIZE;
 
 
@@ -194,10 +791,7 @@ userinit(void)
 
   p = allocproc();
   
-  // //0번에 있던 것을 제거해주고,3에 넣어줘야함.
-  remove_proc_from_mlfq(p); //원래 있던 곳에세 제거  
-  p->q_level = 3; //init프로세스는 q_level을 3으로 고정시켜야하기 때문이다.
-  add_proc_to_mlfq(p,p->q_level); //3번째 레벨의 큐에 삽입 시켜준다.
+  p->q_level = 3; //init프로세스는 q_level을 3으로 고정시켜야하기 때문이다. 런큐에는 RUNNABLE이 될 때 들어간다.
  
 
   initproc = p;
@@ -219,11 +813,11 @@ userinit(void)
   p->cwd = namei("/");
 
 
-  acquire(&ptable.lock);
+  acquire(proclock(p));
 
-  p->state = RUNNABLE;   //프로세스의 상태를 runnable로 설정하여 실행가능 상태로 변경
+  make_runnable(p);   //프로세스의 상태를 runnable로 설정하여 실행가능 상태로 변경하고 3번째 레벨의 런큐에 넣는다.
 
-  release(&ptable.lock);
+  release(proclock(p));
 }
 
 //가상 메모리의 크기를 확장하거나 축소하는 함수다.
@@ -265,7 +859,9 @@ fork(void)
     //실패한 경우는 커널 스택을 해제하고, UNUSED로 상태를 바꾼 다음에 -1을 리런시킨다.
     kfree(np->kstack);
     np->kstack = 0;
-    np->state = UNUSED;
+    acquire(&ptable.lock);
+    free_proc_slot(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
@@ -285,15 +881,12 @@ fork(void)
   //pid를 설정한다.
   pid = np->pid;
   // // 프로세스의 pid로 판단하여 해당하는 이름을 가진 경우에는 q_level고정
-  //mlfq에 넣어주는 것이다.
-  add_proc_to_mlfq(np,0);
-
+  np->q_level = 0;
   if(np->pid == 2){
     //쉘 프로세스는 q_level 3으로 이동시키면 된다.
-    remove_proc_from_mlfq(np);
     np->q_level = 3;
-    add_proc_to_mlfq(np,np->q_level);
   }
+  np->rq_cpu = idlest_cpu(); //가장 한가한 cpu의 런큐에 넣는다.
 
 
   #ifdef DEBUG
@@ -304,10 +897,13 @@ fork(void)
 
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
-
+  child_link(&curproc->children, np); //wait과 exit이 전체 테이블 대신 자식 리스트만 보도록 부모에 연결한다.
   release(&ptable.lock);
 
+  acquire(proclock(np));
+  make_runnable(np); //RUNNABLE로 바꾸면서 해당 레벨의 런큐에 넣어준다.
+  release(proclock(np));
+
   return pid;
 }
 
@@ -318,7 +914,7 @@ void
 exit(void)
 {
   struct proc *curproc = myproc();
-  struct proc *p;
+  struct proc *parent;
   int fd;
 
   if(curproc == initproc)
@@ -343,19 +939,29 @@ exit(void)
   acquire(&ptable.lock);
 
  //부모 프로세스가 wait으로 자식 프로세스를 기다릴 수 있기 때문에 부모 프로세스를 꺠운다.
-  wakeup1(curproc->parent);
+  parent = curproc->parent;
+  wakeup(parent);
+
+  //부모의 zombies 리스트로 옮겨서 부모가 wait에서 바로 찾을 수 있게 한다.
+  child_unlink(&parent->children, curproc);
+  child_link(&parent->zombies, curproc);
+  parent->nzombie++;
 
   //현재 프로세스가 종료가 되면 현재 프로세스가 갖고 있던 자식 프로세스는 고아 프로세스가 되기 때문에 해당 프로세스들을 init 프로세스에게 넘긴다.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
-      p->parent = initproc;
-      if(p->state == ZOMBIE)
-        wakeup1(initproc);
-    }
+  //전체 테이블을 훑지 않고 자식 리스트를 init의 리스트에 이어 붙인다.
+  child_splice(&initproc->children, &curproc->children, initproc);
+  if(curproc->nzombie > 0){
+    initproc->nzombie += child_splice(&initproc->zombies, &curproc->zombies, initproc);
+    curproc->nzombie = 0;
+    wakeup(initproc);
   }
 
   // Jump into the scheduler, never to return.
+  //스케줄러로 넘어갈 때까지 자기 락을 잡고 있는다. wait은 자식의 락을 잡아본 뒤에 커널 스택을 해제하므로
+  //이 cpu가 아직 이 스택 위에 있는 동안 부모가 스택을 해제하지 못한다.
+  acquire(proclock(curproc));
   curproc->state = ZOMBIE;
+  release(&ptable.lock);
   sched();
   panic("zombie exit");
 }
@@ -375,37 +981,38 @@ wait(void)
   for(;;){
 
     //havekids는 현재 프로세스가 자식 프로세스를 갖고 있는지 판단하는 것이다.
-    havekids = 0;
-
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
-      if(p->state == ZOMBIE){
-        //여기서 큐에 있는 것을  제거해주면 된다.
-        remove_proc_from_mlfq(p);
-        
-        // Found one.
-        pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
-        p->q_level = 0;
-        p->priority=0;
-        p->cpu_burst = 0;
-        p->cpu_wait = 0;
-        p->io_wait_time = 0;
-        p->end_time = 0;
-        p->next = 0;
-        p->stack_cpu_burst=0;
-        release(&ptable.lock);
-        return pid;
-      }
+    havekids = curproc->children != 0 || curproc->zombies != 0;
+
+    //종료된 자식은 zombies 리스트에 모여 있으므로 맨 앞의 것을 바로 거둔다.
+    if(curproc->nzombie > 0){
+      p = curproc->zombies;
+      child_unlink(&curproc->zombies, p);
+      curproc->nzombie--;
+      //ZOMBIE는 런큐에 들어가 있지 않지만 혹시 모르니 제거해준다.
+      remove_proc_from_mlfq(p);
+      //자식의 cpu가 아직 sched에서 스케줄러로 넘어가는 중일 수 있으므로, 그 cpu가 자식의 락을 놓을 때까지 기다린 뒤에 스택을 해제한다.
+      acquire(proclock(p));
+      release(proclock(p));
+      
+      // Found one.
+      pid = p->pid;
+      kfree(p->kstack);
+      p->kstack = 0;
+      freevm(p->pgdir);
+      p->parent = 0;
+      p->name[0] = 0;
+      p->killed = 0;
+      free_proc_slot(p); //pid 해시에서 빼고 UNUSED로 바꿔 freeslot 스택에 돌려준다.
+      p->q_level = 0;
+      p->priority=0;
+      p->cpu_burst = 0;
+      p->cpu_wait = 0;
+      p->io_wait_time = 0;
+      p->end_time = 0;
+      p->heap_idx = -1;
+      p->stack_cpu_burst=0;
+      release(&ptable.lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
@@ -430,93 +1037,43 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int self = c - cpus;
+  struct runq *rq = &runqs[self];
   c->proc = 0;
   for(;;){
 
     //인터럽트 플래그를 설정하여 인터럽트를 허용하며 , 외부 인터럽트를 받으며 이벤트가 발생하면 처리할 수 있게 됩니다.
     sti();
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    //네 개의 큐를 순환하면서 스케줄링을 할 수 있도록 설정
-
-    for(int i = 0 ; i< NUM_QUEUES; i ++){
-        //큐룰 초기화하여 생성.
-        struct proc* current = 0;
-        struct proc* biggest = 0;
-        //돌면서 우선순위가 제일 높은 것을 선택.
-   
-        current = ptable.mlfq[i];
-        //헤더가 null이면 바로 실행 종료
-        if(current == 0){
-          continue;
-        }
-    
-        int biggestIo = -1;
-        int  currWait = 99999999;
-        // 첫 번째 RUNNABLE 상태의 프로세스를 찾기
-          while (current != 0) {
-              if (current->state == RUNNABLE) {
-                  biggest = current;
-                  biggestIo = current->io_wait_time;
-                  currWait = current->cpu_wait;
-                  break;
-              }
-              current = current->next;
-          }
-        //실행시킬 프로세스를 선택하는 과정
-        while(current != 0 ){
-            if(current->state != RUNNABLE){
-              current = current->next;
-              continue;
-            }
-            //가장 우선순위가 높은 프세스를 찾기 위해서 우선적으로 io_wait_time을 가장 큰 것을 선택하고
-            //io_wait_time이 같은 경우에는 cpu_wait 을 비교하여 먼저 들어온 프로세스는 cpu_wait이 클 것이기에 cpu_wait이 작은 프로세스를 선택하고
-            //io_wait_time, cpu_wait도 같은 경우에는 큐에서 가장 앞에 집어넣어줌으로써 해결을 하고 pid가 더 큰 경우가 나중에 들어온 것이기에 pid가 더 큰 것을 선택한다.
-            if(current->io_wait_time > biggestIo || 
-               (current->io_wait_time == biggestIo && current->cpu_wait < currWait)||
-               (current->io_wait_time == biggestIo && current->cpu_wait == currWait && current->pid > biggest->pid)) {
-                   biggestIo = current->io_wait_time;
-                   biggest = current;
-                   currWait = current->cpu_wait;
-            }
-            current = current->next;
-        }
-        
-        if(biggest == 0 ){
-          continue;
-        }
-        if(biggest->state != RUNNABLE){
-          continue;
-        }
+    //자기 런큐가 비어있거나 부하 분산 주기가 되면 가장 바쁜 cpu에서 일을 가져온다.
+    balance_runqs(self);
 
-        c->proc = biggest;
-        switchuvm(biggest);//swtch를 통해 현재 프로세스의 문맥을 저장하고, 선택된 프로세스 p의 문맥을 복원한다.
-        biggest->state = RUNNING;
-        //만약 3인 경우에는 그냥 실행시켜주면 됨
-        swtch(&(c->scheduler), biggest->context);
-        switchkvm();
-        if(biggest->q_level !=3){
-          //3이 아니라면 내려 주어야 한다.
-          remove_proc_from_mlfq(biggest);
-          biggest->q_level++;
-          biggest->cpu_burst = 0;
-          biggest->cpu_wait = 0;
-          biggest->io_wait_time = 0;
-          //하위 큐에 삽입시켜주어야 한다.
-          add_proc_to_mlfq(biggest,biggest->q_level);
-        }else{
-          //3번큐 cpu_wait는 없애야 한다.
-          biggest->cpu_wait = 0;
-          biggest->cpu_burst = 0;
-        }
-        c->proc = 0;
-  
-        if(ptable.mlfq[0]!=0||ptable.mlfq[1]!=0||ptable.mlfq[2]!=0){
-            break;
-        }
-    }
-    release(&ptable.lock);
+    //자기 cpu의 런큐에서 비트맵으로 비어있지 않은 가장 높은 레벨을 찾고 그 레벨 힙의 루트를 꺼낸다.
+    //힙의 루트가 io_wait_time, cpu_wait, pid 순서로 가장 우선순위가 높기 때문에 다시 훑어볼 필요가 없고,
+    //할 일이 없는 cpu는 어떤 락도 잡지 않는다.
+    p = pick_proc_from_mlfq(rq);
+    if(p == 0)
+      continue;
+
+    //문맥 전환은 p의 락만 잡고 하기 때문에 서로 다른 프로세스로 전환하는 cpu들은 서로 기다리지 않는다.
+    //p가 yield나 sleep으로 방금 다른 cpu를 내려놓았다면 그 cpu가 아직 swtch로 문맥을 저장하는 중일 수 있는데,
+    //그 cpu는 스케줄러로 돌아간 뒤에야 p의 락을 놓으므로 여기서 락을 잡으면 저장이 끝난 문맥으로 전환하게 된다.
+    //잡은 락은 p가 sched에서 돌아온 뒤(yield, sleep, forkret)에 놓는다.
+    acquire(proclock(p));
+    //런큐에서 기다린 시간을 cpu_wait에 반영하고, 지금부터 cpu_burst가 늘어나도록 기준 tick을 잡는다.
+    p->cpu_wait = ticks - p->wait_origin;
+    p->run_origin = ticks - p->cpu_burst;
+    mlfq_set_slice(p);
+    c->proc = p;
+    switchuvm(p);//swtch를 통해 현재 프로세스의 문맥을 저장하고, 선택된 프로세스 p의 문맥을 복원한다.
+    p->state = RUNNING;
+    swtch(&(c->scheduler), p->context);
+    switchkvm();
+
+    //레벨 조정은 yield와 sleep에서 런큐에 다시 들어가기 전에 이미 끝났다.
+    //p가 sched를 부르기 전에 잡은 자기 락을 p 대신 놓는다.
+    c->proc = 0;
+    release(proclock(p));
 
   }
 }
@@ -532,8 +1089,8 @@ sched(void)
   struct proc *p = myproc();//현새 실행 중인 프로세스를 가리킨다.
 
 
-  if(!holding(&ptable.lock)) // 프로세스 테이블에 대한 락이 되어있는지 확인
-    panic("sched ptable.lock");
+  if(!holding(proclock(p))) // 자기 프로세스 락을 잡고 있는지 확인
+    panic("sched p->lock");
   if(mycpu()->ncli != 1) //인터럽트가 비활성화 된 상태에서만 호출해야함
     panic("sched locks");
   if(p->state == RUNNING) //현재 프로세스의 상태가 RUNNING이 아니어야 한다.
@@ -552,10 +1109,13 @@ sched(void)
 void
 yield(void)
 {
-  acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE; //현재 프로세스를 실행가능한 프로세스 바꾸고 스케줄링 시킨다.
+  struct proc *p = myproc();
+
+  acquire(proclock(p));  //DOC: yieldlock
+  mlfq_demote(p); //런큐에 다시 들어가기 전에 레벨을 조정한다.
+  make_runnable(p); //현재 프로세스를 실행가능한 프로세스 바꾸고 런큐에 넣어 스케줄링 시킨다.
   sched(); //이를 통해서 현재 프로세스를 멈추고 다음 프로세스를 스케쥴링 되어서 실행시키는 함수다.
-  release(&ptable.lock);
+  release(proclock(p));
 }
 
 
@@ -566,8 +1126,8 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);  //락을 해제한다.
+  // Still holding p's lock from scheduler.
+  release(proclock(myproc()));  //락을 해제한다.
 
   if (first) { //첫 번째 프로세스가 스케줄링될 때만 이 블록이 실행되게끔 만든다.
     // Some initialization functions must be run in the context
@@ -595,19 +1155,22 @@ sleep(void *chan, struct spinlock *lk)
   if(lk == 0)  //프로세스가 잠들기 전에 가지고 있던 락
     panic("sleep without lk");
 
-  // Must acquire ptable.lock in order to
+  // Must acquire p's lock in order to
   // change p->state and then call sched.
-  // Once we hold ptable.lock, we can be
+  // Once we hold chan's bucket lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup runs with ptable.lock locked),
+  // (wakeup runs with the bucket lock locked),
   // so it's okay to release lk.
-  if(lk != &ptable.lock){  //DOC: sleeplock0
-    acquire(&ptable.lock);  //DOC: sleeplock1
-    release(lk);
-  }
+  acquire(sleepq_lock(chan));  //DOC: sleeplock1
+  acquire(proclock(p));
+  release(lk);
   // Go to sleep.
+  mlfq_demote(p); //깨어나서 런큐에 들어갈 레벨을 미리 조정한다.
+  p->sleep_origin = ticks - p->io_wait_time; //지금부터 io_wait_time이 늘어나도록 기준 tick을 잡는다.
   p->chan = chan; //현재 프로세스가 대기할 채널을 설정/ 채널은 프로세스가 깨어날 때 어떤 이벤트나 신호가 발생했는지 구분하는 용도로 사용되어짐
   p->state = SLEEPING; //프로세스의 상태를 sleeping으로 설정하여 프로세스가 대기 상태임을 표시함. 스케줄러가 이 프로세스를 실행하지 않도록 하기 위함이다.
+  sleepq_insert(p); //wakeup이 전체 테이블을 훑지 않고 chan의 버킷만 보도록 넣어둔다.
+  release(sleepq_lock(chan)); //버킷에 들어갔으므로 이제부터 오는 wakeup은 p를 찾는다.
 
   sched();
 
@@ -615,33 +1178,30 @@ sleep(void *chan, struct spinlock *lk)
   p->chan = 0;
 
   // Reacquire original lock.
-  if(lk != &ptable.lock){  //DOC: sleeplock2
-    release(&ptable.lock);
-    acquire(lk);
-  }
+  release(proclock(p));  //DOC: sleeplock2
+  acquire(lk);
 }
 
 // 특정 chan에 잠들어 있는 프로세스를 깨우는 역할을 한다.
 // 주어진 채널에서 대기 중인 모든 프로세스를 찾아서 RUNNABLE로 바꾼다 -> 즉, 그냥 진짜 프로세스를 깨우는 함수다.
-// 락이 걸린 것을 전제조건으로 수행하는 함수다.
-static void
-wakeup1(void *chan)
-{
-  struct proc *p;
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
-}
-
-// 위의 wakeup1함수를 호출하기 위한 전제조건인 락을 설정하는 함수다.
-// 해당 함수를 통해서 락을 설정하고 wakeup1을 호출하여 상태를 변경한다.
+// chan의 해시 버킷에 있는 프로세스만 보면 되기 때문에 매 tick마다 불리는 wakeup(&ticks)도 전체 테이블을 훑지 않는다.
+// 그 버킷의 락만 잡기 때문에 다른 chan을 깨우거나 문맥 전환을 하는 cpu와 경쟁하지 않는다.
 void
 wakeup(void *chan)
 {
-  acquire(&ptable.lock);
-  wakeup1(chan);
-  release(&ptable.lock);
+  struct proc *p, *next;
+
+  acquire(sleepq_lock(chan));
+  for(p = *sleepq_bucket(chan); p != 0; p = next){
+    next = p->sleep_next; //make_runnable이 버킷에서 떼어내므로 미리 다음 것을 기억한다.
+    if(p->chan == chan){
+      //p가 아직 sched에서 스케줄러로 넘어가는 중이라면 그 cpu가 p의 락을 놓을 때까지 기다린다.
+      acquire(proclock(p));
+      make_runnable(p); //깨어난 프로세스는 지금까지 쌓인 io_wait_time을 기준으로 런큐에 들어간다.
+      release(proclock(p));
+    }
+  }
+  release(sleepq_lock(chan));
 }
 
 
@@ -652,18 +1212,29 @@ int
 kill(int pid)
 {
   struct proc *p;
-
-  acquire(&ptable.lock);  //프로세스 테이블에 대한 락을 획득함.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    //pid와 일치하는 프로세스를 찾음
-    if(p->pid == pid){
-      p->killed = 1; //killed 플래그를 1로 설정함 프로세스는 주기적으로 자신의 killed 상태를 확인하며 이 값이 1이면 종료 절차를 진행하게 됨.
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING) //프로세스가 잠들어있는 상태면 RUNNABLE로 변경하여 프로세스가 깨어나도록 함.
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
+  void *chan;
+  int same;
+
+  acquire(&ptable.lock);  //프로세스 테이블에 대한 락을 획득함. 잡고 있는 동안 p의 슬롯은 해제되지 않는다.
+  //pid와 일치하는 프로세스를 pid 해시에서 찾음
+  if((p = findproc(pid)) != 0){
+    p->killed = 1; //killed 플래그를 1로 설정함 프로세스는 주기적으로 자신의 killed 상태를 확인하며 이 값이 1이면 종료 절차를 진행하게 됨.
+    // Wake process from sleep if necessary.
+    //깨우려면 chan의 버킷 락을 먼저 잡아야 하므로 chan은 락 없이 읽고, 락을 잡은 뒤에도 같은 chan일 때만 깨운다.
+    //그 사이에 깨어나서 다른 chan으로 다시 잠들었다면 새 chan으로 다시 해 본다.
+    while((chan = p->chan) != 0){
+      acquire(sleepq_lock(chan));
+      acquire(proclock(p));
+      same = p->chan == chan;
+      if(same && p->state == SLEEPING) //프로세스가 잠들어있는 상태면 RUNNABLE로 변경하여 프로세스가 깨어나도록 함.
+        make_runnable(p);
+      release(proclock(p));
+      release(sleepq_lock(chan));
+      if(same)
+        break;
     }
+    release(&ptable.lock);
+    return 0;
   }
   release(&ptable.lock);
   return -1;
@@ -1,4 +1,9 @@
 #define NUM_QUEUES 4  // 큐 레벨 개수
+#define BALANCE_TICKS 20  // cpu 런큐들의 부하 분산 주기 (tick)
+#define AGING_TICKS 250   // 런큐에서 이만큼 기다리면 한 단계 위의 큐로 올라간다.
+#define AGING_WHEEL 256   // aging 타이머 휠의 칸 수, AGING_TICKS보다 커야 한 칸에 같은 tick만 모인다.
+#define MLFQ_QUANTA { 10, 20, 40, 80 }  // 부팅할 때 쓰는 레벨별 할당 시간 (tick)
+#define SLEEPQ_BITS 6     // 대기 채널 해시 테이블의 버킷 수는 1 << SLEEPQ_BITS개다.
 
 // Per-CPU state
 struct cpu {
@@ -58,7 +63,26 @@ struct proc {
   int io_wait_time;            // 해당 큐에서 sleeping 상태 시간
   int end_time;                // cpu 총 사용 할당량을 의미
   int priority;
-  struct proc *next;           // 다음 프로세스를 가리키는 포인터
+  int heap_idx;                // 런큐 힙에서의 위치, 없으면 -1
+  int on_mlfq;                 // 런큐에 들어가 있는지 여부
+  int rq_cpu;                  // 들어갈 런큐의 cpu 번호
+  uint wait_origin;            // 런큐에 있는 동안 cpu_wait = ticks - wait_origin
+  uint sleep_origin;           // 잠들어 있는 동안 io_wait_time = ticks - sleep_origin
+  uint run_origin;             // 실행 중에는 cpu_burst = ticks - run_origin
+  uint aging_deadline;         // aging이 일어날 tick
+  struct proc *aging_next;     // 타이머 휠의 같은 칸에 있는 다음 프로세스
+  struct proc *aging_prev;     // 타이머 휠의 같은 칸에 있는 이전 프로세스
+  int on_wheel;                // 타이머 휠에 들어가 있는지 여부
+  uint slice_end;              // 이 tick이 되면 cpu를 내려놓는다
+  int slice_exit;              // slice_end에 end_time을 다 쓰게 되어 종료해야 하는지 여부
+  struct proc *sleep_next;     // 같은 대기 채널 버킷에 있는 다음 프로세스
+  struct proc *sleep_prev;     // 같은 대기 채널 버킷에 있는 이전 프로세스
+  struct proc *children;       // 아직 실행 중인 자식 프로세스 리스트
+  struct proc *zombies;        // 종료되어 wait을 기다리는 자식 프로세스 리스트
+  struct proc *sibling_next;   // 부모의 children 또는 zombies 리스트에서 다음 형제
+  struct proc *sibling_prev;   // 부모의 children 또는 zombies 리스트에서 이전 형제
+  int nzombie;                 // zombies 리스트에 있는 자식 수
+  struct proc *pid_next;       // pid 해시의 같은 버킷에 있는 다음 프로세스
   int stack_cpu_burst;
 };
 
@@ -67,6 +91,11 @@ struct proc {
 
 extern void add_proc_to_mlfq(struct proc *p, int q_level);
 extern void remove_proc_from_mlfq(struct proc *p);
+extern void mlfq_tick(void);
+extern void mlfq_set_slice(struct proc *p);
+extern struct proc* findproc(int pid);
+extern int set_mlfq_quantum(int level, int quantum);
+extern void update_proc_in_mlfq(struct proc *p, int q_level, int cpu_burst, int cpu_wait, int io_wait_time);
 
 
 // Process memory is laid out contiguously, low addresses first:
@@ -104,6 +104,7 @@ extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_set_proc_info(void);
+extern int sys_set_mlfq_quantum(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -128,6 +129,7 @@ static int (*syscalls[])(void) = {
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
 [SYS_set_proc_info] sys_set_proc_info,
+[SYS_set_mlfq_quantum] sys_set_mlfq_quantum,
 };
 
 void
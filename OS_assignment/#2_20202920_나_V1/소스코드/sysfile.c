@@ -17,13 +17,6 @@
 #include "fcntl.h"
 
 
-//ptable 가져오기
-extern struct {
-    struct spinlock lock;
-    struct proc proc[NPROC];
-    struct proc *mlfq[NUM_QUEUES];  // 4개의 큐 레벨을 위한 배열
-} ptable;
-
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -472,21 +465,20 @@ sys_set_proc_info(void)
       argint(4, &end_time) < 0) {
     return -1;
   }
+  //레벨이 런큐 비트맵의 인덱스로 쓰이기 때문에 범위를 벗어나면 안 된다.
+  if (q_level < 0 || q_level >= NUM_QUEUES)
+    return -1;
   struct proc *curproc = myproc();
 
-  int original  = myproc()->q_level;
   // 프로세스 정보 업데이트
-  // 시스템 콜 진입 지점 로그
-  //이때 큐에 들어가서 실행될 수 있도록 한다.
-  acquire(&ptable.lock);
-  remove_proc_from_mlfq(curproc);
-  curproc->q_level = q_level;
-  curproc->cpu_burst = cpu_burst;
-  curproc->cpu_wait = cpu_wait;
-  curproc->io_wait_time = io_wait_time;
+  // 시스템 콜을 호출한 프로세스는 보통 RUNNING 상태라 값만 바뀌고, yield나 sleep 이후 바뀐 레벨로 런큐에 들어간다.
+  // 런큐에 들어가 있다면 힙에서의 위치도 바뀐 값에 맞게 다시 맞춰진다.
+  // 실행 중인 자기 자신의 값만 바꾸므로 도중에 타이머 인터럽트가 slice_end를 보지 않도록 인터럽트만 막는다.
+  pushcli();
+  update_proc_in_mlfq(curproc, q_level, cpu_burst, cpu_wait, io_wait_time);
   curproc->end_time = end_time;
-  add_proc_to_mlfq(curproc,curproc->q_level);
-  release(&ptable.lock);
+  mlfq_set_slice(curproc); //바뀐 레벨과 end_time으로 이번 실행이 끝날 tick을 다시 계산한다.
+  popcli();
 
   
   //디버그 모드로 실행될 때만 출력되게끔 생성
@@ -495,4 +487,17 @@ sys_set_proc_info(void)
   #endif 
 
   return 0;
-}
\ No newline at end of file
+}
+
+//sys_set_mlfq_quantum
+//큐 레벨별 할당 시간을 커널을 다시 빌드하지 않고 바꿀 수 있게 한다.
+int
+sys_set_mlfq_quantum(void)
+{
+  int level;
+  int quantum;
+
+  if (argint(0, &level) < 0 || argint(1, &quantum) < 0)
+    return -1;
+  return set_mlfq_quantum(level, quantum);
+}
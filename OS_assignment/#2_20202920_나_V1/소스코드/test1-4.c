@@ -0,0 +1,41 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+int main(int argc, char *argv[]) {
+    printf(1, "start quantum_test\n");
+
+    // 잘못된 레벨과 할당 시간은 거부되어야 한다.
+    if (set_mlfq_quantum(-1, 10) != -1 || set_mlfq_quantum(4, 10) != -1 ||
+        set_mlfq_quantum(0, 0) != -1) {
+        printf(1, "quantum_test: invalid argument accepted\n");
+        exit();
+    }
+
+    // 1번 큐의 할당 시간을 5 ticks로 줄인다. 이전 값(20)이 반환된다.
+    int old = set_mlfq_quantum(1, 5);
+    printf(1, "mlfq[1] quantum: %d -> 5\n", old);
+
+    int pid = fork();
+    if (pid < 0) {
+        exit();
+    }
+
+    if (pid == 0) {
+        // 자식 프로세스 설정
+        set_proc_info(1, 0, 0, 0, 30);  // 큐 1에서 시작, 30 ticks 수행
+
+        // 작업 수행
+        while (1) {
+            // 무한 루프
+        }
+    } else {
+        // 부모 프로세스는 자식 프로세스가 종료될 때까지 대기
+        while (wait() != -1);
+    }
+
+    // 원래 값으로 돌려놓는다.
+    set_mlfq_quantum(1, old);
+    printf(1, "end of quantum_test\n");
+    exit();
+}
@@ -14,14 +14,6 @@ extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
 
-//ptable 가져오기
-extern struct {
-    struct spinlock lock;
-    struct proc proc[NPROC];
-    struct proc *mlfq[NUM_QUEUES];  // 4개의 큐 레벨을 위한 배열
-} ptable;
-
-
 void
 tvinit(void)
 {
@@ -47,15 +39,19 @@ idtinit(void)
 void
 trap(struct trapframe *tf)
 {
+  //트랩을 처리하는 동안 현재 프로세스는 바뀌지 않으므로 한 번만 읽어둔다.
+  //yield로 다른 cpu에서 돌아오더라도 같은 프로세스의 커널 스택 위에서 이어서 실행된다.
+  struct proc *curproc = myproc();
+
   //시스템 콜이 발생한 경우
   if(tf->trapno == T_SYSCALL){
     //프로세스가 killed 요청 상태인지 확인한다.
-    if(myproc()->killed)
+    if(curproc->killed)
       exit();
     //시스템 콜이 실행되면서 프로세스의 상태가 변경되는 것을 기록하기 위해서 프로세스의 트랩 프레임 포인터에 저장시킨다.
-    myproc()->tf = tf;
+    curproc->tf = tf;
     syscall(); //시스템 콜을 실제로 처리하는 함수다.
-    if(myproc()->killed) //시스템 콜을 처리하고 나서 다시 killed 상태인지 확인하고 프로세스를 종료한다.
+    if(curproc->killed) //시스템 콜을 처리하고 나서 다시 killed 상태인지 확인하고 프로세스를 종료한다.
       exit();
     return;
   }
@@ -70,58 +66,11 @@ trap(struct trapframe *tf)
       wakeup(&ticks); //타이머 틱을 기다리고 있는 프로세스들이 다시 실행될 수 있도록 하는 것이다. 이렇게 해서 tick의 주소를 주는 것이다.
       release(&tickslock);
     }
-    int lock_ok = 1;
-    if(!holding(&ptable.lock)){
-        acquire(&ptable.lock);
-        lock_ok = 0;
-    }
-    //여기에 aging적용
-    struct proc *current = 0;
-
-    for(int i = 0; i< NUM_QUEUES;i++){
-      
-      current = ptable.mlfq[i];
-      if(current == 0 ){
-        continue;
-      }
-       
-      //current에 대한 조건들을 증가시켜준다.
-      while(current != 0){
-        if (current->state == RUNNABLE) {
-          current->cpu_wait++;  // CPU 대기 시간 증가
-        } else if (current->state == SLEEPING) {
-          current->io_wait_time++;  // I/O 대기 시간 증가
-        } else if (current->state == RUNNING){
-          current->cpu_burst++;
-        }
 
-  
-
-        //shell idle init은 aging하지 않는다.
-        if((current->pid != 0) && (current-> pid != 1) && (current->pid != 2)){ 
-          if(current->cpu_wait>=250){
-            if(current->q_level > 0){
-              #ifdef DEBUG
-                if(current->pid > 3){
-                cprintf("PID: %d Aging\n",current->pid);
-                }
-              #endif
-              remove_proc_from_mlfq(current);
-              current->q_level --;
-              current->io_wait_time = 0;
-              current->cpu_burst = 0;
-              current->cpu_wait= 0;
-              add_proc_to_mlfq(current,current->q_level);
-            }
-          }
-      }
-      current = current ->next;
-    }
-    }
-    if(lock_ok == 0){
-      release(&ptable.lock);
-      lock_ok = 1;
-    }
+    //여기에 aging적용
+    //대기 시간들은 기준 tick으로부터 계산되기 때문에 프로세스를 훑으며 세지 않고,
+    //자기 cpu 런큐의 타이머 휠에서 aging 시각이 된 프로세스만 올린다.
+    mlfq_tick();
 
     lapiceoi();  // 로컬 apic에게 인터럽트 처리가 끝났음을 알리는 신호를 보낸다.
     break;
@@ -149,7 +98,7 @@ trap(struct trapframe *tf)
 
   //PAGEBREAK: 13
   default:
-    if(myproc() == 0 || (tf->cs&3) == 0){
+    if(curproc == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
       // 알 수 없는 트랩이 커널 모드에서 발생하였으면 panic을 호출한다.
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
@@ -160,150 +109,40 @@ trap(struct trapframe *tf)
     // 사용자 모드인 경우는 killed 상태로 바꾼다.
     cprintf("pid %d %s: trap %d err %d on cpu %d "
             "eip 0x%x addr 0x%x--kill proc\n",
-            myproc()->pid, myproc()->name, tf->trapno,
+            curproc->pid, curproc->name, tf->trapno,
             tf->err, cpuid(), tf->eip, rcr2());
-    myproc()->killed = 1;
+    curproc->killed = 1;
   }
 
   // killed 상태인 프로세스가 사용자 모드에 있는지 확인하고 exit을 호출해 프로세스를 종료한다.
-  if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
+  if(curproc && curproc->killed && (tf->cs&3) == DPL_USER)
     exit();
 
   // Force process to give up CPU on clock tick.
   // If interrupts were on while locks held, would need to check nlock.
-  if(myproc() && myproc()->state == RUNNING &&
+  if(curproc && curproc->state == RUNNING &&
      tf->trapno == T_IRQ0+IRQ_TIMER){
     //필요한 시간만큼 있다가 yield되어서 다음 프로세스로 이동될 수 있도록 한다.
-    //시간이 지남에 따라 이동
-    
-
-    //큐의 레벨이 0인 경우
-    if(myproc()->q_level == 0){
-          if(myproc()->end_time > 0){ //set_proc_info 시스템콜을 사용하였을 때만 수행될 수 있게 한다.
-        
-        if(myproc()->cpu_burst <= 10){
-        if((myproc()->end_time - myproc()->stack_cpu_burst) <=10){
-            if((myproc()->end_time-myproc()->stack_cpu_burst) <= myproc()->cpu_burst){
-              myproc()->stack_cpu_burst += myproc()->cpu_burst;
-            }
-            //지금까지 모인 cpu_burst의 시간이 end_time보다 더 커지면 종료하게 한다.
-        if(myproc()->stack_cpu_burst >= myproc()->end_time){
-          #ifdef DEBUG
-            cprintf("PID: %d uses %d ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->cpu_burst,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-            cprintf("PID: %d, used %d ticks. terminated\n",myproc()->pid,myproc()->end_time);
-          #endif
-          exit();
-        }
+    //큐 레벨별 할당 시간과 end_time까지 남은 시간 중 먼저 오는 tick을 실행을 시작할 때 slice_end로 계산해 두었기 때문에
+    //매 tick마다는 비교 한 번만 하면 된다.
+    if((int)(ticks - curproc->slice_end) >= 0){
+      curproc->cpu_burst = ticks - curproc->run_origin;
+      curproc->stack_cpu_burst += curproc->cpu_burst;
+      #ifdef DEBUG
+        cprintf("PID: %d uses %d ticks in mlfq[%d], total(%d/%d)\n",curproc->pid,curproc->cpu_burst,curproc->q_level,curproc->stack_cpu_burst,curproc->end_time);
+      #endif
+      if(curproc->slice_exit){
+        //지금까지 모인 cpu_burst의 시간이 end_time에 도달하면 종료하게 한다.
+        #ifdef DEBUG
+          cprintf("PID: %d, used %d ticks. terminated\n",curproc->pid,curproc->end_time);
+        #endif
+        exit();
       }
-      } 
+      yield();
     }
-      if(myproc()->cpu_burst >= 10){
-          //일반적으로 0큐에서는 10만큼 tick이 지나면 yield를 호출되게끔 한다.
-          if(myproc()->state == RUNNING){
-            myproc()->stack_cpu_burst += myproc()->cpu_burst;
-          }
-          #ifdef DEBUG
-            cprintf("PID: %d uses 10 ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-          #endif
-           yield();
-      }
-    } else if(myproc()->q_level == 1){
-      if(myproc()->end_time > 0){
-      
-        if(myproc()->cpu_burst <= 20){
-        if((myproc()->end_time - myproc()->stack_cpu_burst) <=20){
-            if((myproc()->end_time-myproc()->stack_cpu_burst) <= myproc()->cpu_burst){
-              myproc()->stack_cpu_burst += myproc()->cpu_burst;
-            }
-        if(myproc()->stack_cpu_burst >= myproc()->end_time){
-            #ifdef DEBUG
-            cprintf("PID: %d uses %d ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->cpu_burst,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-            cprintf("PID: %d, used %d ticks. terminated\n",myproc()->pid,myproc()->end_time);
-            #endif
-          exit();
-        }
-      }
-      } 
-      }
-          
-          if(myproc()->cpu_burst >= 20){
-              if(myproc()->state == RUNNING){
-                myproc()->stack_cpu_burst += myproc()->cpu_burst;
-              }
-              #ifdef DEBUG
-                cprintf("PID: %d uses 20 ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-              //시간이 다 되어 끝난 경우 DEBUG 모드 일때만 출력을 하고 yield된다.
-              #endif
-              yield();
-          }
-    } else if(myproc()->q_level == 2){
-      //큐 레벨이 2일 경우도 큐레벨이 1일때와 0일때와 동일하게 동작한다.
-      if(myproc()->end_time > 0){
-  
-        if(myproc()->cpu_burst <= 40){
-        if((myproc()->end_time - myproc()->stack_cpu_burst) <=40){
-            if((myproc()->end_time-myproc()->stack_cpu_burst) <= myproc()->cpu_burst){
-              myproc()->stack_cpu_burst += myproc()->cpu_burst;
-            }
-        if(myproc()->stack_cpu_burst >= myproc()->end_time){
-          #ifdef DEBUG  
-            cprintf("PID: %d uses %d ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->cpu_burst,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-            cprintf("PID: %d, used %d ticks. terminated\n",myproc()->pid,myproc()->end_time);
-          #endif
-          exit();
-        }
-      }
-      } 
-
-    }
-      if(myproc()->cpu_burst >= 40){
-        if(myproc()->state == RUNNING){
-            myproc()->stack_cpu_burst +=myproc()->cpu_burst;
-          }
-          #ifdef DEBUG
-          cprintf("PID: %d uses 40 ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-          #endif
-          yield(); 
-      }
-    } else if(myproc()->q_level == 3){
-      //큐레벨이 3인 경우
-      int reamaining = 0;
-      if(myproc()->end_time > 0){
-          reamaining = (myproc()->end_time - myproc()->stack_cpu_burst);
-
-          if(reamaining < 80){
-            if(myproc()->cpu_burst%80 >= reamaining){
-                myproc()->stack_cpu_burst += myproc()->cpu_burst%80;
-                //남은 시간보다 80이 더 크면 해당 로직을 실행하여 종료시킨다.
-              if(myproc()->stack_cpu_burst >= myproc()->end_time ){
-                #ifdef DEBUG
-                cprintf("PID: %d uses %d ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->cpu_burst%80,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-                cprintf("PID: %d, used %d ticks. terminated\n",myproc()->pid,myproc()->end_time);
-                #endif
-                exit();
-              }
-       }
-      }
-      }
+  }
 
-      if(myproc()->cpu_burst >= 80){
-              //큐레벨이 3일때는 cpu_burst가 종료되기 전까지 계속 증가할 수 있는데 80보다 큰 값을 계속 넣어주면 문제가되기때문에
-              //80으로 나눴을 때 나머지가 0인 경우에 증가하고 yield되도록 설정한다.
-              int divi = myproc()->cpu_burst%80;
-              if(divi==0){
-                myproc()->stack_cpu_burst += 80;
-                #ifdef DEBUG
-                  cprintf("PID: %d uses 80 ticks in mlfq[%d], total(%d/%d)\n",myproc()->pid,myproc()->q_level,myproc()->stack_cpu_burst,myproc()->end_time);
-                #endif
-                //시간이 다 되어 끝난 경우
-       
-                yield(); 
-               }
-      }
-    }
-    }
-  
   // Check if the process has been killed since we yielded
-  if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
+  if(curproc && curproc->killed && (tf->cs&3) == DPL_USER)
     exit();
 }
@@ -24,6 +24,7 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 int set_proc_info(int q_level,int cpu_burst,int cpu_wait_time, int io_wait_time, int end_time); //새로운 시스템 콜 추가
+int set_mlfq_quantum(int level, int ticks); //큐 레벨별 할당 시간 변경, 이전 값을 반환한다.
 
 // ulib.c
 int stat(const char*, struct stat*);
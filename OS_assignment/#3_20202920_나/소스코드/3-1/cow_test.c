@@ -0,0 +1,55 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+void _error(const char *msg) {
+    printf(1, "%s\ncow_test failed...\n", msg);
+    exit();
+}
+
+int main() {
+    char *addr;
+    char *lazy;
+    int pid;
+
+    printf(1, "### Copy-on-write test start\n");
+
+    // 부모가 미리 값을 써둔 페이지
+    addr = sbrk(4096 * 4);
+    if (addr == (char *)-1)
+        _error("sbrk error");
+    addr[0] = 'P';
+    addr[4096 * 3] = 'P';
+
+    // 아직 물리 메모리가 할당되지 않은 지연할당 페이지
+    if ((int)(lazy = (char *)ssusbrk(4096, 0)) < 0)
+        _error("Allocation error");
+
+    pid = fork();
+    if (pid < 0)
+        _error("fork error");
+
+    if (pid == 0) {
+        // 자식은 부모가 쓴 값을 그대로 읽을 수 있어야 한다.
+        if (addr[0] != 'P' || addr[4096 * 3] != 'P')
+            _error("child read error");
+        // 처음 쓸 때 페이지가 복사되므로 부모에게는 보이지 않아야 한다.
+        addr[0] = 'C';
+        lazy[0] = 'C';
+        if (addr[0] != 'C' || lazy[0] != 'C')
+            _error("child write error");
+        memstat();
+        exit();
+    }
+    wait();
+
+    if (addr[0] != 'P' || addr[4096 * 3] != 'P')
+        _error("parent page changed by child");
+    if (lazy[0] != 0)
+        _error("parent lazy page changed by child");
+    addr[4096 * 3] = 'Q';
+    printf(1, "ok\n");
+
+    printf(1, "### Copy-on-write test passed...\n");
+    exit();
+}
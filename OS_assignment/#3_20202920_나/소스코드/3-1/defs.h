@@ -11,6 +11,14 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct memstat;
+struct fmap;
+struct swapstat;
+struct buddystat;
+struct faultstat;
+struct slabcache;
+struct vma;
+struct shm;
 
 // bio.c
 void            binit(void);
@@ -26,6 +34,8 @@ void            panic(char*) __attribute__((noreturn));
 
 // exec.c
 int             exec(char*, char**);
+void            fmapdup(struct fmap*, struct fmap*);
+void            fmapput(struct fmap*);
 
 // file.c
 struct file*    filealloc(void);
@@ -70,6 +80,15 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kincref(char*);
+char*           kalloc4m(void);
+char*           kzalloc(void);
+int             kzerofill(void);
+void            kfree4m(char*);
+char*           kallocpages(int);
+void            kfreepages(char*, int);
+void            getbuddystat(struct buddystat*);
+int             krefcount(char*);
 
 // kbd.c
 void            kbdintr(void);
@@ -89,6 +108,17 @@ void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
 
+// mmap.c
+struct vma*     findvma(struct proc*, uint);
+uint            mmapbase(struct proc*);
+int             vmacheck(struct proc*, uint, uint);
+int             mmap(int, int, struct file*, int);
+int             munmap(uint, int);
+int             vmafault(struct proc*, struct vma*, uint, int);
+int             vmadup(struct proc*, struct proc*);
+void            vmaclose(struct vma*);
+struct vma*     vmaalloc(struct proc*, uint);
+
 // mp.c
 extern int      ismp;
 void            mpinit(void);
@@ -98,6 +128,7 @@ void            picenable(int);
 void            picinit(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
@@ -123,8 +154,29 @@ int             wait(void);
 void            wakeup(void*);
 void            yield(void);
 int             procMemstat(void);
-int ssusbrkAlloc(int pageSize);
+int ssusbrkAlloc(int pageSize, int flags);
 int ssusbrkDealloc(int pageSize, int delayTicks);
+void            reclaimtick(void);
+void            dfreecheck(void);
+void            fillmemstat(struct proc*, struct memstat*);
+
+// swap.c
+void            swapinit(void);
+int             swapout(void);
+void            swapin(int, char*);
+void            swapdup(int);
+void            swapfree(int);
+void            getswapstat(struct swapstat*);
+
+// shm.c
+void            shminit(void);
+int             shmget(int, int, int);
+int             shmat(int, int);
+int             shmdt(uint);
+int             shmctl(int, int);
+int             shmmap(pde_t*, struct vma*);
+void            shmhold(struct shm*);
+void            shmdrop(struct shm*);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -138,6 +190,11 @@ void            release(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
 
+// slab.c
+void            slabinit(struct slabcache*, char*, uint, void (*)(void*));
+void*           slaballoc(struct slabcache*);
+void            slabfree(struct slabcache*, void*);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
@@ -155,7 +212,7 @@ char*           strncpy(char*, const char*, int);
 
 // syscall.c
 int             argint(int, int*);
-int             argptr(int, char**, int);
+int             argptr(int, char**, int, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
@@ -176,6 +233,7 @@ void            uartintr(void);
 void            uartputc(int);
 
 // vm.c
+extern char*    zeropage;
 void            seginit(void);
 void            kvmalloc(void);
 pde_t*          setupkvm(void);
@@ -193,6 +251,20 @@ void            clearpteu(pde_t *pgdir, char *uva);
 int             allocuvm_without_alloc(pde_t *pgdir, uint oldsz, uint newsz);
 pte_t *         walkpgdir(pde_t *pgdir, const void *va, int alloc);
 int             mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm);
+int             pgfault(struct proc *p, uint va, uint err);
+void            lazylargeuvm(pde_t *pgdir, uint oldsz, uint newsz);
+void            vmstat(pde_t*, struct memstat*);
+int             fileuvm(pde_t*, uint, uint);
+int             uvmprefault(struct proc*, uint, uint, int);
+int             killmap(pde_t*, uint);
+uint            uvmevict(pde_t*, pte_t*, int);
+int             copyvma(pde_t*, pde_t*, uint, uint);
+int             lazymap(pde_t*, uint, int);
+char*           uvmkalloc(int);
+void            tlbflush(pde_t*);
+void            tlbinval(pde_t*, uint);
+void            getfaultstat(struct proc*, struct faultstat*, struct faultstat*);
+void            tlbidle(void);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
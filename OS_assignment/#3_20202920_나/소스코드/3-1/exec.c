@@ -0,0 +1,184 @@
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "defs.h"
+#include "x86.h"
+#include "elf.h"
+
+// 프로그램 세그먼트는 바로 읽어오지 않고 실행 파일 구간(fmap)으로 기록해 둔다.
+// 파일 내용이 있는 페이지는 PTE_FILE로 표시해서 처음 접근할 때 pgfault에서 읽어오고,
+// 세그먼트 사이의 빈 곳과 파일 뒤의 bss는 지연할당 페이지로 둔다.
+// fmap이 모자라면 남은 세그먼트는 예전처럼 바로 읽어온다.
+int
+exec(char *path, char **argv)
+{
+  char *s, *last;
+  int i, off, nfmap;
+  uint argc, sz, sp, fend, ustack[3+MAXARG+1];
+  struct elfhdr elf;
+  struct inode *ip;
+  struct proghdr ph;
+  struct fmap fmap[NFMAP], oldfmap[NFMAP];
+  struct vma oldvma[NVMA];
+  pde_t *pgdir, *oldpgdir;
+  struct proc *curproc = myproc();
+
+  begin_op();
+
+  if((ip = namei(path)) == 0){
+    end_op();
+    cprintf("exec: fail\n");
+    return -1;
+  }
+  ilock(ip);
+  pgdir = 0;
+  nfmap = 0;
+  memset(fmap, 0, sizeof(fmap));
+
+  // Check ELF header
+  if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
+    goto bad;
+  if(elf.magic != ELF_MAGIC)
+    goto bad;
+
+  if((pgdir = setupkvm()) == 0)
+    goto bad;
+
+  // Load program into memory.
+  sz = 0;
+  for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
+    if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
+      goto bad;
+    if(ph.type != ELF_PROG_LOAD)
+      continue;
+    if(ph.memsz < ph.filesz)
+      goto bad;
+    if(ph.vaddr + ph.memsz < ph.vaddr)
+      goto bad;
+    if(ph.vaddr % PGSIZE != 0)
+      goto bad;
+    if(ph.vaddr + ph.memsz >= KERNBASE)
+      goto bad;
+    //앞 세그먼트와 겹치는 부분은 바로 읽어오는데, 이미 PTE_FILE이나 지연할당으로 둔 페이지에는 물리 메모리가 없다.
+    if(ph.vaddr < sz && nfmap > 0)
+      goto bad;
+    if(nfmap == NFMAP || ph.vaddr < sz){
+      if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+        goto bad;
+      if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
+        goto bad;
+      continue;
+    }
+    fend = PGROUNDUP(ph.vaddr + ph.filesz);
+    if(ph.vaddr > sz && allocuvm_without_alloc(pgdir, sz, ph.vaddr) == 0)
+      goto bad;
+    if(fileuvm(pgdir, ph.vaddr, fend) < 0)
+      goto bad;
+    if(ph.vaddr + ph.memsz > fend && allocuvm_without_alloc(pgdir, fend, ph.vaddr + ph.memsz) == 0)
+      goto bad;
+    fmap[nfmap].ip = idup(ip);
+    fmap[nfmap].va = ph.vaddr;
+    fmap[nfmap].filesz = ph.filesz;
+    fmap[nfmap].off = ph.off;
+    nfmap++;
+    sz = ph.vaddr + ph.memsz;
+  }
+  iunlockput(ip);
+  end_op();
+  ip = 0;
+
+  // Allocate two pages at the next page boundary.
+  // Make the first inaccessible.  Use the second as the user stack.
+  sz = PGROUNDUP(sz);
+  if((sz = allocuvm(pgdir, sz, sz + 2*PGSIZE)) == 0)
+    goto bad;
+  clearpteu(pgdir, (char*)(sz - 2*PGSIZE));
+  sp = sz;
+
+  // Push argument strings, prepare rest of stack in ustack.
+  for(argc = 0; argv[argc]; argc++) {
+    if(argc >= MAXARG)
+      goto bad;
+    sp = (sp - (strlen(argv[argc]) + 1)) & ~3;
+    if(copyout(pgdir, sp, argv[argc], strlen(argv[argc]) + 1) < 0)
+      goto bad;
+    ustack[3+argc] = sp;
+  }
+  ustack[3+argc] = 0;
+
+  ustack[0] = 0xffffffff;  // fake return PC
+  ustack[1] = argc;
+  ustack[2] = sp - (argc+1)*4;  // argv pointer
+
+  sp -= (3+argc+1) * 4;
+  if(copyout(pgdir, sp, ustack, (3+argc+1)*4) < 0)
+    goto bad;
+
+  // Save program name for debugging.
+  for(last=s=path; *s; s++)
+    if(*s == '/')
+      last = s+1;
+  safestrcpy(curproc->name, last, sizeof(curproc->name));
+
+  // Commit to the user image.
+  oldpgdir = curproc->pgdir;
+  memmove(oldfmap, curproc->fmap, sizeof(oldfmap));
+  memmove(curproc->fmap, fmap, sizeof(fmap));
+  //mmap 영역은 새 프로그램에 넘겨주지 않는다.
+  memmove(oldvma, curproc->vma, sizeof(oldvma));
+  memset(curproc->vma, 0, sizeof(curproc->vma));
+  curproc->pgdir = pgdir;
+  curproc->sz = sz;
+  curproc->tf->eip = elf.entry;  // main
+  curproc->tf->esp = sp;
+  switchuvm(curproc);
+  freevm(oldpgdir);
+  begin_op();
+  fmapput(oldfmap);
+  end_op();
+  vmaclose(oldvma);
+  return 0;
+
+ bad:
+  if(pgdir)
+    freevm(pgdir);
+  if(ip){
+    iunlockput(ip);
+    end_op();
+  }
+  if(nfmap > 0){
+    begin_op();
+    fmapput(fmap);
+    end_op();
+  }
+  return -1;
+}
+
+// fork에서 부모의 실행 파일 구간을 자식에게 복사한다. 자식도 같은 inode를 참조하므로 참조 수를 올린다.
+void
+fmapdup(struct fmap *dst, struct fmap *src)
+{
+  int i;
+
+  for(i = 0; i < NFMAP; i++){
+    dst[i] = src[i];
+    if(dst[i].ip)
+      idup(dst[i].ip);
+  }
+}
+
+// 실행 파일 구간들이 잡고 있던 inode를 놓는다. iput 때문에 트랜잭션 안에서 호출해야 한다.
+void
+fmapput(struct fmap *fm)
+{
+  int i;
+
+  for(i = 0; i < NFMAP; i++){
+    if(fm[i].ip){
+      iput(fm[i].ip);
+      fm[i].ip = 0;
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "mman.h"
+
+static char *names[NFLTTYPE] = { "lazy", "zero", "cow", "file", "swap", "kill" };
+
+void _error(const char *msg) {
+    printf(1, "%s\nfaultstat_test failed...\n", msg);
+    exit();
+}
+
+void _print(const char *who, struct faultstat *st) {
+    int t, b;
+
+    printf(1, " [%s]\n", who);
+    for (t = 0; t < NFLTTYPE; t++) {
+        if (st->count[t] == 0)
+            continue;
+        printf(1, "  %s: %d faults, %d kcycles, hist:", names[t], st->count[t], st->kcycles[t]);
+        for (b = 0; b < NFLTBUCKET; b++)
+            printf(1, " %d", st->hist[t][b]);
+        printf(1, "\n");
+    }
+}
+
+int main() {
+    struct faultstat self0, all0, self, all;
+    char *lazy;
+
+    printf(1, "### Faultstat test start\n");
+
+    if (getfaultstat(&self0, &all0) < 0)
+        _error("getfaultstat error");
+
+    // 읽기 폴트는 zero 페이지로, 쓰기 폴트는 새 페이지로 처리된다.
+    if ((int)(lazy = (char *)ssusbrk(4096 * 4, 0)) < 0)
+        _error("Allocation error");
+    if (lazy[0] != 0)
+        _error("lazy page not zero");
+    lazy[4096 * 3] = 'S';
+    if (getfaultstat(&self, &all) < 0)
+        _error("getfaultstat error");
+    if (self.count[FLT_ZERO] <= self0.count[FLT_ZERO] || self.count[FLT_LAZY] <= self0.count[FLT_LAZY])
+        _error("fault count error");
+
+    // 범위를 벗어난 접근으로 죽은 자식의 폴트는 전체 통계에만 남는다.
+    if (fork() == 0) {
+        *(volatile char *)0x7FFFF000 = 'S';  // KERNBASE 바로 아래, 매핑되지 않은 주소
+        exit();
+    }
+    wait();
+    if (getfaultstat(&self, &all) < 0)
+        _error("getfaultstat error");
+    if (all.count[FLT_KILL] <= all0.count[FLT_KILL] || self.count[FLT_KILL] != self0.count[FLT_KILL])
+        _error("kill count error");
+
+    _print("self", &self);
+    _print("all", &all);
+    printf(1, "### Faultstat test passed...\n");
+    exit();
+}
@@ -0,0 +1,497 @@
+// Physical memory allocator, intended to allocate
+// memory for user processes, kernel stacks, page table pages,
+// and pipe buffers. Allocates 4096-byte pages.
+// 물리 메모리는 buddy 방식으로 관리해서 2^order 페이지의 연속된 덩어리도 내줄 수 있다.
+// 해제된 덩어리는 짝(buddy)도 비어 있으면 합쳐서 더 큰 덩어리로 만든다.
+// 한 페이지짜리 할당과 해제는 cpu별 캐시에서 락 없이 처리하고 buddy에는 MAGBATCH 페이지씩 한꺼번에 들르게 한다.
+// 참조 수는 lock xadd로 바꾸고, 0으로 채워둔 페이지는 따로 zlock으로 보호해서 폴트와 fork가 kmem.lock을 잡지 않게 한다.
+// 락 순서는 kmem.lock -> kmem.zlock이다.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "x86.h"
+#include "mman.h"
+
+void freerange(void *vstart, void *vend);
+extern char end[]; // first address after kernel loaded from ELF file
+                   // defined by the kernel linker script in kernel.ld
+
+// 4MB(PSE) 페이지 하나의 order, buddy가 관리하는 가장 큰 덩어리다.
+#define LPGORDER 10
+// 할 일이 없는 cpu가 미리 0으로 채워두는 페이지 수의 상한
+#define NZPAGE 256
+// cpu마다 락 없이 쓰는 페이지 캐시(magazine)의 크기와, 전역 free list와 한 번에 주고받는 페이지 수
+#define NMAG     32
+#define MAGBATCH 16
+
+struct run {
+  struct run *next;
+  struct run *prev;   // buddy free list에서만 쓴다. 합칠 때 짝을 list 중간에서 바로 뺄 수 있게 한다.
+};
+
+// cpu 하나가 가진 free 페이지들. 그 cpu는 pushcli한 상태에서 cmpxchg로 넣고 빼고,
+// buddy가 비었을 때 다른 cpu는 xchg로 list를 통째로 가져간다. 넣는 쪽은 주인 cpu뿐이라 ABA 문제가 없다.
+struct mag {
+  struct run *list;
+  int n;              // list의 페이지 수. 주인 cpu만 바꾸므로 빼앗긴 뒤에는 실제보다 클 수 있다.
+};
+
+struct {
+  struct spinlock lock;
+  int use_lock;
+  struct run *freelist[NBUDDYORDER]; // order별 free list, order k의 덩어리는 2^k 페이지이고 그 크기로 정렬되어 있다.
+  uint nfree[NBUDDYORDER];        // order별 free 덩어리 수
+  uchar border[PHYSTOP >> PTXSHIFT]; // free 덩어리의 첫 페이지면 order+1, 아니면 0
+  struct spinlock zlock;          // zfreelist와 nzfree를 보호한다.
+  struct run *zfreelist;          // 미리 0으로 채워둔 페이지들의 free list
+  int nzfree;                     // zfreelist에 있는 페이지 수
+  ushort ref[PHYSTOP >> PTXSHIFT]; // 물리 페이지별 참조 수, copy-on-write로 여러 프로세스가 한 페이지를 공유할 때 쓴다.
+  struct mag mag[NCPU];           // cpu별 free 페이지 캐시, 비면 buddy에서 채우고 넘치면 돌려준다.
+} kmem;
+
+// *addr가 old면 new로 바꾸고, 바꾸기 전의 값을 반환한다.
+static inline uint
+cas(volatile uint *addr, uint old, uint new)
+{
+  uint prev;
+
+  asm volatile("lock; cmpxchgl %2, %1" :
+               "=a" (prev), "+m" (*addr) :
+               "r" (new), "0" (old) :
+               "memory", "cc");
+  return prev;
+}
+
+// pfn번 페이지의 참조 수에 d를 더하고 더하기 전의 값을 반환한다.
+static inline ushort
+refadd(uint pfn, ushort d)
+{
+  asm volatile("lock; xaddw %0, %1" :
+               "+r" (d), "+m" (kmem.ref[pfn]) :
+               :
+               "memory", "cc");
+  return d;
+}
+
+// 주인 cpu가 pushcli한 상태에서 자기 캐시에 페이지를 넣는다.
+static void
+magpush(struct mag *m, struct run *r)
+{
+  struct run *old;
+
+  do {
+    old = m->list;
+    r->next = old;
+  } while(cas((uint*)&m->list, (uint)old, (uint)r) != (uint)old);
+  m->n++;
+}
+
+// 주인 cpu가 pushcli한 상태에서 자기 캐시의 페이지를 하나 꺼낸다. 비었으면 0을 반환한다.
+// 다른 cpu가 list를 가져간 뒤에 r->next를 읽으면 값이 틀릴 수 있지만, 그때는 cmpxchg가 실패해서 다시 읽는다.
+static struct run*
+magpop(struct mag *m)
+{
+  struct run *r;
+
+  do {
+    if((r = m->list) == 0){
+      m->n = 0;
+      return 0;
+    }
+  } while(cas((uint*)&m->list, (uint)r, (uint)r->next) != (uint)r);
+  m->n--;
+  return r;
+}
+
+static void
+bpush(struct run *r, int order)
+{
+  r->prev = 0;
+  r->next = kmem.freelist[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.freelist[order] = r;
+  kmem.border[V2P(r) >> PTXSHIFT] = order + 1;
+  kmem.nfree[order]++;
+}
+
+static void
+bunlink(struct run *r, int order)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelist[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.border[V2P(r) >> PTXSHIFT] = 0;
+  kmem.nfree[order]--;
+}
+
+// 2^order 페이지 덩어리를 하나 꺼낸다. 그 크기가 없으면 더 큰 덩어리를 반씩 쪼개서 남는 절반들을 돌려놓는다.
+// kmem.lock을 잡은 상태(또는 락을 쓰기 전)에서 호출해야 한다.
+static struct run*
+balloc(int order)
+{
+  struct run *r;
+  int k;
+
+  for(k = order; k < NBUDDYORDER && kmem.freelist[k] == 0; k++)
+    ;
+  if(k == NBUDDYORDER)
+    return 0;
+  r = kmem.freelist[k];
+  bunlink(r, k);
+  while(k > order){
+    k--;
+    bpush((struct run*)((char*)r + (PGSIZE << k)), k);
+  }
+  return r;
+}
+
+// 2^order 페이지 덩어리를 돌려준다. 짝도 같은 크기로 비어 있으면 합쳐서 한 단계 큰 덩어리로 만든다.
+// kmem.lock을 잡은 상태(또는 락을 쓰기 전)에서 호출해야 한다.
+static void
+bfree(struct run *r, int order)
+{
+  uint pfn, bpfn;
+
+  pfn = V2P(r) >> PTXSHIFT;
+  while(order < LPGORDER){
+    bpfn = pfn ^ (1 << order);
+    if(bpfn >= (PHYSTOP >> PTXSHIFT) || kmem.border[bpfn] != order + 1)
+      break;
+    bunlink((struct run*)P2V(bpfn << PTXSHIFT), order);
+    pfn &= ~(1 << order);
+    order++;
+  }
+  bpush((struct run*)P2V(pfn << PTXSHIFT), order);
+}
+
+// Initialization happens in two phases.
+// 1. main() calls kinit1() while still using entrypgdir to place just
+// the pages mapped by entrypgdir on free list.
+// 2. main() calls kinit2() with the rest of the physical pages
+// after installing a full page table that maps them on all cores.
+void
+kinit1(void *vstart, void *vend)
+{
+  initlock(&kmem.lock, "kmem");
+  initlock(&kmem.zlock, "kzero");
+  kmem.use_lock = 0;
+  freerange(vstart, vend);
+}
+
+// 한 페이지씩 buddy에 넣으면서 합쳐지므로 4MB로 정렬된 구간은 4MB 덩어리가 된다.
+void
+kinit2(void *vstart, void *vend)
+{
+  freerange(vstart, vend);
+  kmem.use_lock = 1;
+}
+
+void
+freerange(void *vstart, void *vend)
+{
+  char *p;
+  p = (char*)PGROUNDUP((uint)vstart);
+  for(; p + PGSIZE <= (char*)vend; p += PGSIZE){
+    kmem.ref[V2P(p) >> PTXSHIFT] = 1; // kfree가 참조 수를 0으로 내리면서 free list에 넣도록 한다.
+    kfree(p);
+  }
+}
+//PAGEBREAK: 21
+// Free the page of physical memory pointed at by v,
+// which normally should have been returned by a
+// call to kalloc().  (The exception is when
+// initializing the allocator; see kinit above.)
+// 공유 중인 페이지는 참조 수만 줄이고, 마지막 참조가 사라질 때 실제로 해제한다.
+void
+kfree(char *v)
+{
+  struct run *r;
+  struct mag *m;
+  ushort n;
+
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kfree");
+
+  //줄이기 전의 참조 수가 1이었으면 마지막 참조라서 실제로 해제한다.
+  if((n = refadd(V2P(v) >> PTXSHIFT, (ushort)-1)) == 0)
+    panic("kfree: ref");
+  if(n > 1)
+    return;
+
+  // Fill with junk to catch dangling refs.
+  memset(v, 1, PGSIZE);
+
+  r = (struct run*)v;
+  if(!kmem.use_lock){
+    bfree(r, 0);
+    return;
+  }
+
+  //이 cpu의 캐시에 넣고, 넘치면 MAGBATCH 페이지를 한꺼번에 buddy로 돌려준다.
+  pushcli();
+  m = &kmem.mag[cpuid()];
+  magpush(m, r);
+  if(m->n > NMAG){
+    acquire(&kmem.lock);
+    while(m->n > NMAG - MAGBATCH && (r = magpop(m)) != 0)
+      bfree(r, 0);
+    release(&kmem.lock);
+  }
+  popcli();
+}
+
+// buddy에서 한 페이지를 꺼낸다. kmem.lock을 잡은 상태(또는 락을 쓰기 전)에서 호출해야 한다.
+// buddy가 비었으면 0으로 채워둔 페이지라도 쓴다.
+static struct run*
+kget(void)
+{
+  struct run *r;
+
+  if((r = balloc(0)) != 0)
+    return r;
+  if(kmem.use_lock)
+    acquire(&kmem.zlock);
+  if((r = kmem.zfreelist) != 0){
+    kmem.zfreelist = r->next;
+    kmem.nzfree--;
+  }
+  if(kmem.use_lock)
+    release(&kmem.zlock);
+  return r;
+}
+
+// buddy도 zfreelist도 비었을 때 다른 cpu의 캐시를 통째로 가져와서 한 페이지를 쓰고 나머지는 buddy로 돌려준다.
+// 모두 비었으면 0을 반환한다.
+static struct run*
+magsteal(int self)
+{
+  struct run *r, *s;
+  int i;
+
+  for(i = 0; i < NCPU; i++){
+    if(i == self)
+      continue;
+    if((r = (struct run*)xchg((uint*)&kmem.mag[i].list, 0)) == 0)
+      continue;
+    acquire(&kmem.lock);
+    while((s = r->next) != 0){
+      r->next = s->next;
+      bfree(s, 0);
+    }
+    release(&kmem.lock);
+    return r;
+  }
+  return 0;
+}
+
+// Allocate one 4096-byte page of physical memory.
+// Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+// 이 cpu의 캐시에서 락 없이 꺼내고, 캐시가 비었을 때만 buddy에서 MAGBATCH 페이지를 받아온다.
+// buddy까지 비었으면 다른 cpu의 캐시에 남은 페이지를 가져오고, 그마저 없을 때만 0을 반환한다.
+char*
+kalloc(void)
+{
+  struct run *r;
+  struct mag *m;
+  int self;
+
+  if(!kmem.use_lock){
+    if((r = kget()) != 0)
+      kmem.ref[V2P(r) >> PTXSHIFT] = 1;
+    return (char*)r;
+  }
+
+  pushcli();
+  self = cpuid();
+  m = &kmem.mag[self];
+  if(m->list == 0){
+    m->n = 0;
+    acquire(&kmem.lock);
+    while(m->n < MAGBATCH && (r = kget()) != 0)
+      magpush(m, r);
+    release(&kmem.lock);
+  }
+  if((r = magpop(m)) == 0)
+    r = magsteal(self);
+  if(r)
+    kmem.ref[V2P(r) >> PTXSHIFT] = 1;
+  popcli();
+  return (char*)r;
+}
+
+// Allocate one 4096-byte page filled with zeros.
+// 미리 0으로 채워둔 페이지가 있으면 그것을 주고, 없으면 kalloc한 뒤 직접 0으로 채운다.
+char*
+kzalloc(void)
+{
+  struct run *r;
+
+  if(kmem.use_lock)
+    acquire(&kmem.zlock);
+  r = kmem.zfreelist;
+  if(r){
+    kmem.zfreelist = r->next;
+    kmem.nzfree--;
+    kmem.ref[V2P(r) >> PTXSHIFT] = 1;
+  }
+  if(kmem.use_lock)
+    release(&kmem.zlock);
+  if(r){
+    r->next = 0; //free list에 연결할 때 쓴 첫 4바이트도 0으로 돌려놓는다.
+    return (char*)r;
+  }
+  if((r = (struct run*)kalloc()) != 0)
+    memset(r, 0, PGSIZE);
+  return (char*)r;
+}
+
+// 할 일이 없는 cpu가 scheduler에서 호출한다.
+// buddy에서 한 페이지를 꺼내 0으로 채우고 zfreelist에 넣는다. 채울 필요가 없으면 0을 반환한다.
+// 한 번에 한 페이지만 채우므로 그 사이에 RUNNABLE이 된 프로세스가 오래 기다리지 않는다.
+int
+kzerofill(void)
+{
+  struct run *r;
+  int k;
+
+  if(kmem.nzfree >= NZPAGE)
+    return 0;
+  acquire(&kmem.lock);
+  //4MB 페이지로 쓸 덩어리는 쪼개지 않도록 이미 쪼개진 덩어리가 있을 때만 채운다.
+  for(k = 0; k < LPGORDER && kmem.freelist[k] == 0; k++)
+    ;
+  r = k < LPGORDER ? balloc(0) : 0;
+  release(&kmem.lock);
+  if(r == 0)
+    return 0;
+
+  memset(r, 0, PGSIZE);
+
+  acquire(&kmem.zlock);
+  r->next = kmem.zfreelist;
+  kmem.zfreelist = r;
+  kmem.nzfree++;
+  release(&kmem.zlock);
+  return 1;
+}
+
+// 미리 0으로 채워둔 페이지를 모두 buddy로 돌려준다. 짝과 합쳐져서 큰 덩어리가 다시 생길 수 있다.
+// kmem.lock을 잡은 상태(또는 락을 쓰기 전)에서 호출해야 한다.
+static void
+zdrain(void)
+{
+  struct run *r, *next;
+
+  if(kmem.use_lock)
+    acquire(&kmem.zlock);
+  r = kmem.zfreelist;
+  kmem.zfreelist = 0;
+  kmem.nzfree = 0;
+  if(kmem.use_lock)
+    release(&kmem.zlock);
+  for(; r; r = next){
+    next = r->next;
+    bfree(r, 0);
+  }
+}
+
+// 물리적으로 연속된 2^order 페이지를 할당한다. 남은 덩어리가 없으면 0을 반환한다.
+// 참조 수는 첫 4KB 프레임의 ref로 관리하며, 내용은 0으로 채워져 있지 않다.
+// 0으로 채워둔 페이지들이 큰 덩어리를 쪼개고 있을 수 있으므로 실패하면 그것들을 돌려준 뒤 한 번 더 찾는다.
+char*
+kallocpages(int order)
+{
+  struct run *r;
+
+  if(order < 0 || order > LPGORDER)
+    return 0;
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  if((r = balloc(order)) == 0 && kmem.zfreelist){
+    zdrain();
+    r = balloc(order);
+  }
+  if(r)
+    kmem.ref[V2P(r) >> PTXSHIFT] = 1;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+  return (char*)r;
+}
+
+// kallocpages로 받은 덩어리의 참조 수를 줄이고 마지막 참조였으면 buddy로 돌려준다.
+void
+kfreepages(char *v, int order)
+{
+  ushort n;
+
+  if((uint)v % (PGSIZE << order) || v < end || V2P(v) >= PHYSTOP)
+    panic("kfreepages");
+
+  if((n = refadd(V2P(v) >> PTXSHIFT, (ushort)-1)) == 0)
+    panic("kfreepages: ref");
+  if(n > 1)
+    return;
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  bfree((struct run*)v, order);
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Allocate one 4MB physically contiguous page for a PSE mapping.
+// Returns 0 if none is left; the caller falls back to 4KB pages.
+char*
+kalloc4m(void)
+{
+  return kallocpages(LPGORDER);
+}
+
+void
+kfree4m(char *v)
+{
+  kfreepages(v, LPGORDER);
+}
+
+//페이지를 공유하는 프로세스가 하나 늘어날 때 참조 수를 올린다.
+void
+kincref(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kincref");
+
+  refadd(V2P(v) >> PTXSHIFT, 1);
+}
+
+//페이지의 현재 참조 수를 반환한다.
+//1이면 이 페이지를 쓰는 곳이 하나뿐이라서 복사하지 않고 그대로 쓰기를 허용할 수 있다.
+int
+krefcount(char *v)
+{
+  return *(volatile ushort*)&kmem.ref[V2P(v) >> PTXSHIFT];
+}
+
+// buddy의 order별 free 덩어리 수와 cpu 캐시, zero 페이지 수를 st에 채운다.
+void
+getbuddystat(struct buddystat *st)
+{
+  int i;
+
+  acquire(&kmem.lock);
+  for(i = 0; i < NBUDDYORDER; i++)
+    st->nfree[i] = kmem.nfree[i];
+  st->nzero = kmem.nzfree;
+  release(&kmem.lock);
+  //다른 cpu의 캐시는 락 없이 읽으므로 대략적인 값이다.
+  st->nmag = 0;
+  for(i = 0; i < NCPU; i++)
+    st->nmag += kmem.mag[i].n;
+}
@@ -0,0 +1,55 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "mman.h"
+
+void _error(const char *msg) {
+    printf(1, "%s\nmemstat_test failed...\n", msg);
+    exit();
+}
+
+void _stat(struct memstat *st) {
+    if (getmemstat(st) < 0)
+        _error("getmemstat error");
+    printf(1, " vp: %d, rss: %d, zp: %d, lazy: %d, pending: %d\n",
+           st->vpages, st->rss, st->zpages, st->lazy, st->pending);
+}
+
+int main() {
+    struct memstat st0, st;
+    char *lazy;
+
+    printf(1, "### Memstat test start\n");
+
+    _stat(&st0);
+
+    // 지연할당만 하면 물리 메모리는 늘지 않는다.
+    if ((int)(lazy = (char *)ssusbrk(4096 * 4, 0)) < 0)
+        _error("Allocation error");
+    _stat(&st);
+    if (st.vpages != st0.vpages + 4 || st.lazy != st0.lazy + 4 || st.rss != st0.rss)
+        _error("lazy count error");
+
+    // 읽기만 하면 공유 zero 페이지가, 쓰면 새 물리 페이지가 매핑된다.
+    if (lazy[0] != 0)
+        _error("lazy page not zero");
+    lazy[4096 * 2] = 'S';
+    _stat(&st);
+    if (st.zpages != st0.zpages + 1 || st.rss != st0.rss + 1 || st.lazy != st0.lazy + 2)
+        _error("fault count error");
+
+    lazy[0] = 'S';
+    _stat(&st);
+    if (st.zpages != st0.zpages || st.rss != st0.rss + 2)
+        _error("zero page count error");
+
+    // 줄이면 매핑된 페이지와 지연할당 페이지가 모두 빠진다.
+    if (sbrk(-4096 * 4) == (char *)-1)
+        _error("sbrk error");
+    _stat(&st);
+    if (st.vpages != st0.vpages || st.rss != st0.rss || st.lazy != st0.lazy || st.zpages != st0.zpages)
+        _error("dealloc count error");
+
+    printf(1, "### Memstat test passed...\n");
+    exit();
+}
@@ -0,0 +1,65 @@
+#ifndef MMAN_H
+#define MMAN_H
+
+// 사용자 프로그램과 커널이 함께 쓰는 메모리 관련 플래그와 구조체
+
+// ssusbrk로 메모리를 늘릴 때 두 번째 인자로 넘길 수 있는 플래그
+#define SSUSBRK_LARGE   0x40000000  // 4MB로 정렬되어 통째로 들어가는 구간은 4MB 페이지로 지연할당한다.
+
+// mmap의 prot, flags 인자
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+#define MAP_PRIVATE     0x02        // 쓰기는 이 프로세스에만 보이고 파일에 다시 쓰지 않는다.
+#define MAP_ANONYMOUS   0x20        // 파일 없이 0으로 채운 메모리를 만든다.
+
+// shmget, shmat, shmctl의 인자
+#define IPC_PRIVATE     0           // key 대신 넘기면 항상 새 segment를 만든다.
+#define IPC_CREAT       01000       // key에 해당하는 segment가 없으면 만든다.
+#define IPC_RMID        0           // shmctl: 마지막 shmdt 때 segment를 해제한다.
+#define SHM_RDONLY      010000      // shmat: 읽기만 할 수 있게 붙인다.
+
+// getmemstat으로 돌려받는 프로세스의 메모리 사용량, 단위는 모두 4KB 페이지 수다.
+struct memstat {
+  uint vpages;    // 가상 메모리 페이지 수 (sz)
+  uint rss;       // 물리 메모리가 매핑된 페이지 수, 4MB 페이지는 1024로 센다.
+  uint zpages;    // 공유 zero 페이지가 읽기 전용으로 매핑된 페이지 수
+  uint lazy;      // 지연할당만 해두고 아직 물리 메모리가 없는 페이지 수
+  uint pending;   // 지연 해제 큐에 걸려있는 페이지 수
+  uint swapped;   // swap 영역으로 내보낸 페이지 수
+};
+
+// getswapstat으로 돌려받는 시스템 전체의 swap 통계
+struct swapstat {
+  uint nswapin;   // swap 영역에서 읽어온 페이지 수
+  uint nswapout;  // swap 영역으로 내보낸 페이지 수
+  uint nscan;     // clock 바늘이 지나간 PTE 수, 두 번 읽은 값의 차이로 scan rate를 구한다.
+  uint nslot;     // swap slot 전체 수
+  uint nfree;     // 비어있는 swap slot 수
+};
+
+// getbuddystat으로 돌려받는 물리 메모리 할당기의 상태, 단편화 정도를 order별 free 덩어리 수로 본다.
+#define NBUDDYORDER 11  // order 0(4KB)부터 10(4MB)까지
+struct buddystat {
+  uint nfree[NBUDDYORDER];  // order별 free 덩어리 수, order k의 덩어리는 2^k 페이지다.
+  uint nmag;      // cpu별 캐시에 들고 있는 free 페이지 수
+  uint nzero;     // 미리 0으로 채워둔 free 페이지 수
+};
+
+// getfaultstat으로 돌려받는 페이지 폴트 통계의 폴트 종류
+#define FLT_LAZY    0   // 지연할당 페이지에 새 물리 페이지를 할당 (4MB 페이지 포함)
+#define FLT_ZERO    1   // 읽기 폴트라서 공유 zero 페이지만 매핑
+#define FLT_COW     2   // copy-on-write 페이지에 쓰기
+#define FLT_FILE    3   // 실행 파일이나 mmap한 파일에서 읽어옴
+#define FLT_SWAP    4   // swap 영역에서 읽어옴
+#define FLT_KILL    5   // 처리하지 못해서 프로세스를 종료시킨 폴트 (out of bound, protection, 메모리 부족)
+#define NFLTTYPE    6
+#define NFLTBUCKET  16  // hist[0]은 1024 cycle 미만, hist[i]는 2^(9+i) 이상 2^(10+i) 미만, 마지막은 그 이상 전부
+
+// 폴트 종류별 횟수와 rdtsc로 잰 처리 시간
+struct faultstat {
+  uint count[NFLTTYPE];
+  uint kcycles[NFLTTYPE];           // 처리 시간의 합, 1024 cycle 단위
+  uint hist[NFLTTYPE][NFLTBUCKET];  // 처리 시간의 log2 히스토그램
+};
+
+#endif
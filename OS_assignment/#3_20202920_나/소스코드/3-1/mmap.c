@@ -0,0 +1,247 @@
+// mmap/munmap으로 만드는 프로세스의 메모리 영역(VMA)을 관리한다.
+// 힙([0, sz))과 달리 VMA는 KERNBASE 아래에서부터 비어있는 곳을 찾아 들어가며,
+// 중간의 영역을 munmap하면 그 자리를 다음 mmap이 다시 쓴다.
+// 물리 메모리는 처음 접근할 때 pgfault에서 vmafault로 할당하거나 파일에서 읽어온다.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "mman.h"
+
+// va가 들어있는 VMA를 찾는다. 없으면 0을 반환한다.
+struct vma*
+findvma(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->end != 0 && va >= v->start && va < v->end)
+      return v;
+  return 0;
+}
+
+// 가장 낮은 VMA의 시작 주소, 힙은 여기를 넘어서 늘어날 수 없다.
+uint
+mmapbase(struct proc *p)
+{
+  struct vma *v;
+  uint base = KERNBASE;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->end != 0 && v->start < base)
+      base = v->start;
+  return base;
+}
+
+// [va, va+len)이 힙 안이나 VMA 하나 안에 들어있으면 0, 아니면 -1을 반환한다.
+int
+vmacheck(struct proc *p, uint va, uint len)
+{
+  struct vma *v;
+
+  if(va + len < va)
+    return -1;
+  if(va + len <= p->sz)
+    return 0;
+  if((v = findvma(p, va)) != 0 && va + len <= v->end)
+    return 0;
+  return -1;
+}
+
+// len 바이트가 들어갈 빈 구간을 KERNBASE 아래에서부터 찾는다. 없으면 0을 반환한다.
+static uint
+findhole(struct proc *p, uint len)
+{
+  struct vma *v;
+  uint end = KERNBASE;
+
+again:
+  if(end < len || end - len < PGROUNDUP(p->sz))
+    return 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end != 0 && v->start < end && end - len < v->end){
+      end = v->start;
+      goto again;
+    }
+  }
+  return end - len;
+}
+
+// 빈 VMA 항목 하나에 len 바이트짜리 구간을 잡아준다. 항목이나 빈 구간이 없으면 0을 반환한다.
+struct vma*
+vmaalloc(struct proc *p, uint len)
+{
+  struct vma *v;
+  uint start;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end != 0)
+      continue;
+    if((start = findhole(p, len)) == 0)
+      return 0;
+    v->start = start;
+    v->end = start + len;
+    return v;
+  }
+  return 0;
+}
+
+// 현재 프로세스에 len 바이트짜리 영역을 만들고 시작 주소를 반환한다.
+// f가 0이면 0으로 채운 익명 영역이고, 아니면 f의 off부터 읽어온 내용으로 채운다.
+// 쓰기는 이 프로세스에만 보이며(MAP_PRIVATE) 파일에 다시 쓰지 않는다.
+int
+mmap(int len, int prot, struct file *f, int off)
+{
+  struct vma *nv;
+
+  if(len <= 0 || (prot & ~(PROT_READ|PROT_WRITE)) != 0)
+    return -1;
+  if(f && (f->type != FD_INODE || !f->readable || off < 0 || off % PGSIZE != 0))
+    return -1;
+  len = PGROUNDUP(len);
+
+  if((nv = vmaalloc(myproc(), len)) == 0)
+    return -1;
+  nv->prot = prot;
+  nv->f = f ? filedup(f) : 0;
+  nv->off = off;
+  return nv->start;
+}
+
+// 현재 프로세스의 [addr, addr+len)을 해제한다. 영역 중간을 해제하면 VMA가 둘로 나뉜다.
+// 공유 메모리 영역은 shmdt로만 뗄 수 있다.
+int
+munmap(uint addr, int len)
+{
+  struct proc *curproc = myproc();
+  struct vma *v, *nv;
+  struct file *f;
+  uint end;
+
+  if(len <= 0 || addr % PGSIZE != 0)
+    return -1;
+  end = PGROUNDUP(addr + len);
+  if((v = findvma(curproc, addr)) == 0 || end > v->end || v->shm)
+    return -1;
+
+  if(addr > v->start && end < v->end){
+    // 가운데를 잘라내면 뒤쪽을 새 VMA로 만든다.
+    for(nv = curproc->vma; nv < &curproc->vma[NVMA] && nv->end != 0; nv++)
+      ;
+    if(nv == &curproc->vma[NVMA])
+      return -1;
+    *nv = *v;
+    nv->start = end;
+    nv->off = v->off + (end - v->start);
+    if(nv->f)
+      filedup(nv->f);
+    v->end = addr;
+  } else if(addr > v->start){
+    v->end = addr;
+  } else if(end < v->end){
+    v->off += end - v->start;
+    v->start = end;
+  } else {
+    f = v->f;
+    memset(v, 0, sizeof(*v));
+    if(f)
+      fileclose(f);
+  }
+
+  deallocuvm(curproc->pgdir, end, addr);
+  return 0;
+}
+
+// VMA 안에서 아직 매핑되지 않은 페이지에 폴트가 나면 호출된다.
+// 익명 영역은 지연할당 페이지처럼 처리하고, 파일 영역은 버퍼 캐시를 통해 파일 내용을 읽어서 매핑한다.
+int
+vmafault(struct proc *p, struct vma *v, uint va, int write)
+{
+  struct inode *ip;
+  pte_t *pte;
+  char *mem;
+  int perm;
+
+  if(v->f == 0)
+    return lazymap(p->pgdir, va, write);
+
+  if((mem = uvmkalloc(1)) == 0){
+    cprintf("Out of physical memory.\n");
+    return -1;
+  }
+  ip = v->f->ip;
+  ilock(ip);
+  if(readi(ip, mem, v->off + (va - v->start), PGSIZE) < 0){
+    iunlock(ip);
+    kfree(mem);
+    cprintf("Read ERROR\n");
+    return -1;
+  }
+  iunlock(ip);
+  //디스크를 기다리는 동안 munmap 등으로 PTE가 생겼으면 읽어온 내용을 버린다.
+  pte = walkpgdir(p->pgdir, (char*)va, 0);
+  if(pte && *pte != 0){
+    kfree(mem);
+    return 0;
+  }
+  perm = PTE_U;
+  if(v->prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(mappages(p->pgdir, (char*)va, PGSIZE, V2P(mem), perm) < 0){
+    kfree(mem);
+    cprintf("Mappages ERROR\n");
+    return -1;
+  }
+  return 0;
+}
+
+// fork에서 부모의 VMA와 그 안의 페이지들을 자식에게 복사한다. 페이지는 copy-on-write로 공유하고,
+// 공유 메모리 영역은 같은 물리 페이지를 그대로 매핑해서 자식도 붙어있게 한다.
+int
+vmadup(struct proc *np, struct proc *p)
+{
+  struct vma *v;
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    v = &p->vma[i];
+    if(v->end == 0)
+      continue;
+    if(v->shm){
+      if(shmmap(np->pgdir, v) < 0)
+        return -1;
+      shmhold(v->shm);
+    } else if(copyvma(p->pgdir, np->pgdir, v->start, v->end) < 0)
+      return -1;
+    np->vma[i] = *v;
+    if(v->f)
+      filedup(v->f);
+  }
+  return 0;
+}
+
+// 프로세스의 VMA를 모두 비운다. 페이지는 freevm이 해제하므로 파일을 닫고 공유 메모리에서 떨어지기만 한다.
+void
+vmaclose(struct vma *vma)
+{
+  struct vma *v;
+  struct file *f;
+  struct shm *shm;
+
+  for(v = vma; v < &vma[NVMA]; v++){
+    f = v->f;
+    shm = v->shm;
+    memset(v, 0, sizeof(*v));
+    if(f)
+      fileclose(f);
+    if(shm)
+      shmdrop(shm);
+  }
+}
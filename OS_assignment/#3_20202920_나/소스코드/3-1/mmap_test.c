@@ -0,0 +1,57 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "mman.h"
+
+void _error(const char *msg) {
+    printf(1, "%s\nmmap_test failed...\n", msg);
+    exit();
+}
+
+int main() {
+    char *a, *b, *m, buf[512];
+    int fd, i, n;
+
+    printf(1, "### Mmap test start\n");
+
+    // 익명 영역은 0으로 채워져 있고 쓴 내용이 남는다.
+    a = mmap(0, 4096 * 4, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((int)a == -1)
+        _error("mmap error");
+    for (i = 0; i < 4096 * 4; i += 4096) {
+        if (a[i] != 0)
+            _error("anonymous page not zero");
+        a[i] = 'S';
+    }
+
+    // 가운데를 해제하면 그 자리를 다음 mmap이 다시 쓴다.
+    if (munmap(a + 4096, 4096 * 2) < 0)
+        _error("munmap error");
+    if (a[0] != 'S' || a[4096 * 3] != 'S')
+        _error("neighbour page lost");
+    b = mmap(0, 4096 * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b != a + 4096)
+        _error("hole not reused");
+    if (b[0] != 0)
+        _error("reused page not zero");
+
+    // 파일 영역은 read()로 읽은 내용과 같아야 한다.
+    if ((fd = open("README", O_RDONLY)) < 0)
+        _error("open error");
+    m = mmap(0, 4096, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ((int)m == -1)
+        _error("file mmap error");
+    n = read(fd, buf, sizeof(buf));
+    close(fd);
+    for (i = 0; i < n; i++)
+        if (m[i] != buf[i])
+            _error("file content mismatch");
+
+    // 영역을 나눠서 해제했으므로 하나씩 해제한다.
+    if (munmap(a, 4096) < 0 || munmap(b, 4096 * 2) < 0 || munmap(a + 4096 * 3, 4096) < 0 || munmap(m, 4096) < 0)
+        _error("munmap error");
+
+    printf(1, "### Mmap test passed...\n");
+    exit();
+}
@@ -93,14 +93,28 @@ struct segdesc {
 #define PGROUNDUP(sz)  (((sz)+PGSIZE-1) & ~(PGSIZE-1))
 #define PGROUNDDOWN(a) (((a)) & ~(PGSIZE-1))
 
+// PSE를 켜면 PDE 하나가 4MB 페이지를 직접 가리킬 수 있다.
+#define LPGSIZE         (PGSIZE*NPTENTRIES)  // bytes mapped by a large (PSE) page
+#define LPGROUNDUP(sz)  (((sz)+LPGSIZE-1) & ~(LPGSIZE-1))
+#define LPGROUNDDOWN(a) (((a)) & ~(LPGSIZE-1))
+
 // Page table/directory entry flags.
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
+#define PTE_A           0x020   // Accessed
 #define PTE_PS          0x080   // Page Size
+#define PTE_COW         0x200   // copy-on-write로 공유 중인 페이지 (하드웨어가 쓰지 않는 비트)
+#define PTE_FILE        0x400   // PTE_P 없이 쓰이며, 처음 접근할 때 실행 파일에서 읽어올 페이지
+#define PTE_SWAP        0x800   // PTE_P 없이 쓰이며, 주소 자리에 swap slot 번호가 들어있는 페이지
+
+// Page fault error code bits
+#define FEC_PR          0x001   // 페이지가 present인데 보호 위반으로 폴트가 남
+#define FEC_WR          0x002   // 쓰기 때문에 폴트가 남
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
+#define LPTE_ADDR(pde)  ((uint)(pde) & ~(LPGSIZE-1))  // 4MB 페이지 PDE의 물리 주소
 #define PTE_FLAGS(pte)  ((uint)(pte) &  0xFFF)
 
 #ifndef __ASSEMBLER__
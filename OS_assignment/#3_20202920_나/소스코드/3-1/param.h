@@ -0,0 +1,16 @@
+#define NPROC        64  // maximum number of processes
+#define KSTACKSIZE 4096  // size of per-process kernel stack
+#define NCPU          8  // maximum number of CPUs
+#define NOFILE       16  // open files per process
+#define NFILE       100  // open files per system
+#define NINODE       50  // maximum number of active i-nodes
+#define NDEV         10  // maximum major device number
+#define ROOTDEV       1  // device number of file system root disk
+#define MAXARG       32  // max exec arguments
+#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
+#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
+#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define FSSIZE       1000  // size of file system in blocks
+#define NSHM         16  // 시스템 전체의 공유 메모리 segment 수
+#define SHMMAXPAGES 256  // segment 하나의 최대 페이지 수 (1MB)
+#define SWAPPAGES    1024  // fs.img에서 파일 시스템 바로 뒤에 두는 swap 영역의 페이지 수 (Makefile이 여기서 읽어간다)
@@ -6,28 +6,72 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "slab.h"
+#include "mman.h"
 
+//프로세스는 slab에서 받아와서 head부터 이어지는 list로 관리한다.
+//NPROC는 배열 크기가 아니라 동시에 있을 수 있는 프로세스 수의 상한이다.
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct proc *head;
+  int nproc;
 } ptable;
 
+static struct slabcache proccache;
+
 static struct proc *initproc;
 
+//지연 해제 요청 하나. [start, end) 구간을 expiry tick이 되면 해제한다.
+struct dfree {
+  struct proc *proc;
+  int pid;
+  pde_t *pgdir;                // 요청할 때의 페이지 테이블, exec로 바뀌었으면 요청을 버린다.
+  uint start;
+  uint end;
+  uint expiry;
+  int due;                     // 만료되었지만 프로세스가 실행 중이라 프로세스에게 해제를 넘긴 요청
+  struct dfree *next;
+};
+
+//시스템 전체의 지연 해제 큐다. ptable.lock으로 보호한다.
+//head는 expiry 순으로 정렬되어 있어서 reclaim 스레드는 맨 앞만 보면 된다.
+struct {
+  struct dfree ent[NDFREE];
+  struct dfree *head;
+  struct dfree *free;
+} dfreeq;
+
+//큐 맨 앞 요청의 expiry, 비어있으면 0이다. 타이머 인터럽트가 락 없이 읽는다.
+static volatile uint dfree_next;
+
 int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void freeproc(struct proc *p);
 
 
 void print_pde_pte(pde_t *pgdir, uint sz);
+static void memstat(struct proc *p);
+static void dfree_insert(struct dfree *d);
+static void dfree_cancel(struct proc *p);
+static void reclaimer(void);
 
 
 void
 pinit(void)
 {
+  struct dfree *d;
+
   initlock(&ptable.lock, "ptable");
+  slabinit(&proccache, "proc", sizeof(struct proc), 0);
+  swapinit();
+  shminit();
+  for(d = dfreeq.ent; d < &dfreeq.ent[NDFREE]; d++){
+    d->next = dfreeq.free;
+    dfreeq.free = d;
+  }
 }
 
 // Must be called with interrupts disabled
@@ -70,7 +114,7 @@ myproc(void) {
 }
 
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
+// Allocate a proc from the slab cache and link it into ptable.
 // If found, change state to EMBRYO and initialize
 // state required to run in the kernel.
 // Otherwise return 0.
@@ -82,27 +126,35 @@ allocproc(void)
 
   acquire(&ptable.lock);
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock);
-  return 0;
+  if(ptable.nproc >= NPROC || (p = slaballoc(&proccache)) == 0){
+    release(&ptable.lock);
+    return 0;
+  }
+  ptable.nproc++;
+  p->next = ptable.head;
+  ptable.head = p;
 
-found:
   p->state = EMBRYO;
   p->pid = nextpid++;
   p->allowDelayTicks = 0;        // 초기 tick 수는 0
-  p->pending_free_ticks = 0;     // 초기 남은 tick 수는 0
   p->pending_free_pages = 0;     // 초기 해제할 페이지 수는 0
   p->pending_free_addr = 0;      // 초기 해제 시작 주소는 0
+  p->dfree_busy = 0;
+  p->dfree_due = 0;
   memset(&p->ssusbrk_call_time, 0, sizeof(p->ssusbrk_call_time)); // 초기 시간은 0으로 설정
+  p->fault_next = 0;
+  p->fault_seq = 0;
+  p->npin = 0;
+  memset(p->vma, 0, sizeof(p->vma));
+  memset(&p->fst, 0, sizeof(p->fst));
 
   release(&ptable.lock);
 
   // Allocate kernel stack.
   if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(p);
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -160,6 +212,24 @@ userinit(void)
   p->state = RUNNABLE;
 
   release(&ptable.lock);
+
+  // 지연 해제 큐를 비워주는 커널 스레드도 같이 만든다.
+  if((p = allocproc()) == 0)
+    panic("userinit: reclaim");
+  if((p->pgdir = setupkvm()) == 0)
+    panic("userinit: out of memory?");
+  p->context->eip = (uint)reclaimer;
+  safestrcpy(p->name, "reclaim", sizeof(p->name));
+
+  acquire(&ptable.lock);
+
+  //커널 스레드가 사용자 프로세스의 pid를 밀어내지 않도록 0번을 주고 받았던 번호는 돌려놓는다.
+  //아직 다른 프로세스가 만들어지기 전이므로 받은 번호는 nextpid 바로 앞이다.
+  p->pid = 0;
+  nextpid--;
+  p->state = RUNNABLE;
+
+  release(&ptable.lock);
 }
 
 // Grow current process's memory by n bytes.
@@ -172,6 +242,9 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
+    //힙은 mmap 영역 아래까지만 늘어날 수 있다.
+    if(sz + n < sz || sz + n > mmapbase(curproc))
+      return -1;
     if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
   } else if(n < 0){
@@ -179,7 +252,7 @@ growproc(int n)
       return -1;
   }
   curproc->sz = sz;
-  switchuvm(curproc);
+  //줄어든 페이지는 deallocuvm이 TLB에서 비우고, 늘어난 페이지는 TLB에 없으므로 cr3를 다시 올리지 않는다.
   return 0;
 }
 
@@ -202,7 +275,21 @@ fork(void)
   if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
     kfree(np->kstack);
     np->kstack = 0;
-    np->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
+    return -1;
+  }
+  //mmap 영역도 힙과 같이 copy-on-write로 복사한다.
+  if(vmadup(np, curproc) < 0){
+    vmaclose(np->vma);
+    freevm(np->pgdir);
+    np->pgdir = 0;
+    kfree(np->kstack);
+    np->kstack = 0;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
@@ -216,6 +303,7 @@ fork(void)
     if(curproc->ofile[i])
       np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
+  fmapdup(np->fmap, curproc->fmap);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
@@ -250,19 +338,24 @@ exit(void)
       curproc->ofile[fd] = 0;
     }
   }
+  vmaclose(curproc->vma);
 
   begin_op();
   iput(curproc->cwd);
+  fmapput(curproc->fmap);
   end_op();
   curproc->cwd = 0;
 
   acquire(&ptable.lock);
 
+  // 아직 만료되지 않은 지연 해제 요청은 freevm이 한꺼번에 해제하므로 버린다.
+  dfree_cancel(curproc);
+
   // Parent might be sleeping in wait().
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.head; p; p = p->next){
     if(p->parent == curproc){
       p->parent = initproc;
       if(p->state == ZOMBIE)
@@ -289,7 +382,7 @@ wait(void)
   for(;;){
     // Scan through table looking for exited children.
     havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    for(p = ptable.head; p; p = p->next){
       if(p->parent != curproc)
         continue;
       havekids = 1;
@@ -299,11 +392,7 @@ wait(void)
         kfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
+        freeproc(p);
         release(&ptable.lock);
         return pid;
       }
@@ -333,6 +422,7 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int ran;
   c->proc = 0;
   
   for(;;){
@@ -340,10 +430,12 @@ scheduler(void)
     sti();
 
     // Loop over process table looking for process to run.
+    ran = 0;
     acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
+    for(p = ptable.head; p; p = p->next){
+      if(p->state != RUNNABLE || p->dfree_busy)
         continue;
+      ran = 1;
 
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
@@ -353,7 +445,8 @@ scheduler(void)
       p->state = RUNNING;
 
       swtch(&(c->scheduler), p->context);
-      switchkvm();
+      //커널 페이지 테이블로 바꾸지 않고 p의 페이지 테이블을 그대로 둔다.
+      //다음에 p를 다시 실행하면 switchuvm이 cr3를 다시 올리지 않는다.
 
       // Process is done running for now.
       // It should have changed its p->state before coming back.
@@ -361,6 +454,13 @@ scheduler(void)
     }
     release(&ptable.lock);
 
+    // 실행할 프로세스가 없었으면 남는 시간에 페이지를 미리 0으로 채워둬서
+    // 페이지 폴트나 allocuvm에서 memset하는 시간을 줄인다.
+    if(!ran){
+      tlbidle();
+      kzerofill();
+    }
+
   }
 }
 
@@ -460,6 +560,26 @@ sleep(void *chan, struct spinlock *lk)
   }
 }
 
+// ptable에서 p를 빼고 slab으로 돌려준다. ptable.lock을 잡은 상태에서 호출해야 한다.
+// 다음 allocproc이 받아갈 수 있도록 처음(UNUSED) 상태로 돌려놓는다.
+static void
+freeproc(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &ptable.head; *pp != p; pp = &(*pp)->next)
+    ;
+  *pp = p->next;
+  p->next = 0;
+  p->pid = 0;
+  p->parent = 0;
+  p->name[0] = 0;
+  p->killed = 0;
+  p->state = UNUSED;
+  ptable.nproc--;
+  slabfree(&proccache, p);
+}
+
 //PAGEBREAK!
 // Wake up all processes sleeping on chan.
 // The ptable lock must be held.
@@ -468,7 +588,7 @@ wakeup1(void *chan)
 {
   struct proc *p;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+  for(p = ptable.head; p; p = p->next)
     if(p->state == SLEEPING && p->chan == chan)
       p->state = RUNNABLE;
 }
@@ -491,7 +611,7 @@ kill(int pid)
   struct proc *p;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.head; p; p = p->next){
     if(p->pid == pid){
       p->killed = 1;
       // Wake process from sleep if necessary.
@@ -525,7 +645,7 @@ procdump(void)
   char *state;
   uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.head; p; p = p->next){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -544,7 +664,8 @@ procdump(void)
 
 
 //지연할당과 관련된 부분입니다.
-int ssusbrkAlloc(int pageSize)
+//flags에 SSUSBRK_LARGE가 있으면 4MB로 정렬된 구간은 4MB 페이지로 지연할당한다.
+int ssusbrkAlloc(int pageSize, int flags)
 {
   //pageSize가 0이거나 페이지크기의 배수가 아닌 경우에는 return -1
   if(pageSize == 0 || pageSize % PGSIZE != 0){
@@ -557,10 +678,12 @@ int ssusbrkAlloc(int pageSize)
 
     newsz = sz + pageSize;
 
-    if(newsz >= KERNBASE)
-        return -1; // 커널 영역을 침범한 경우에 대한 예외처리
+    if(newsz >= KERNBASE || newsz > mmapbase(curproc))
+        return -1; // 커널 영역이나 mmap 영역을 침범한 경우에 대한 예외처리
     if(allocuvm_without_alloc(curproc->pgdir, sz, newsz) == 0)
         return -1; // 할당 실패
+    if(flags & SSUSBRK_LARGE)
+        lazylargeuvm(curproc->pgdir, sz, newsz);
     curproc->sz = newsz;
 
     return sz; // 이전 브레이크 주소 반환
@@ -569,6 +692,8 @@ int ssusbrkAlloc(int pageSize)
 
 
 //지연해제와 관련된 부분입니다.
+//요청은 시스템 전체의 지연 해제 큐에 expiry 순으로 들어가고, reclaim 스레드가 정확히 그 tick에 해제한다.
+//한 프로세스가 여러 요청을 걸어둘 수 있으며 새 요청은 이미 걸린 구간의 바로 아래를 차지한다.
 int ssusbrkDealloc(int pageSize, int delayTicks)
 {
     // pageSize가 0이거나 페이지 크기의 배수가 아닌 경우에는 return -1
@@ -584,23 +709,34 @@ int ssusbrkDealloc(int pageSize, int delayTicks)
 
     struct proc *curproc = myproc();
     uint sz = curproc->sz;
+    struct dfree *d;
 
-    // pageSize가 현재 프로세스의 메모리 크기보다 큰 경우 에러 처리
-    if(pageSize > sz)
-        return -1;
+    acquire(&ptable.lock);
 
-    // 해제할 페이지 수 계산
-    int num_pages = pageSize / PGSIZE;
+    // 이미 걸린 요청이 있으면 그 아래부터 잘라낸다.
+    uint top = curproc->pending_free_addr ? curproc->pending_free_addr : sz;
 
-    // 해제할 메모리의 시작 주소 계산
-    int dealloc_addr = sz - (curproc->pending_free_pages + num_pages) * PGSIZE;
+    // pageSize가 남은 메모리 크기보다 크거나 큐가 가득 찬 경우 에러 처리
+    if(pageSize > top || (d = dfreeq.free) == 0){
+        release(&ptable.lock);
+        return -1;
+    }
+    dfreeq.free = d->next;
 
+    d->proc = curproc;
+    d->pid = curproc->pid;
+    d->pgdir = curproc->pgdir;
+    d->start = top - pageSize;
+    d->end = top;
+    d->expiry = ticks + delayTicks;
+    d->due = 0;
+    dfree_insert(d);
 
-    // 이전에 해제 요청이 있는 경우 페이지 수 누적 및 tick 값 업데이트
     curproc->allowDelayTicks = delayTicks;
-    curproc->pending_free_pages += num_pages;
-    curproc->pending_free_ticks = delayTicks;
-    curproc->pending_free_addr = dealloc_addr;
+    curproc->pending_free_pages += pageSize / PGSIZE;
+    curproc->pending_free_addr = d->start;
+
+    release(&ptable.lock);
 
     struct rtcdate curDateTime;
     cmostime(&curDateTime);
@@ -619,34 +755,233 @@ int ssusbrkDealloc(int pageSize, int delayTicks)
     return sz;
 }
 
+//요청을 expiry 순서에 맞게 큐에 넣는다. expiry가 같으면 먼저 들어온 요청이 앞에 온다.
+//ptable.lock을 잡은 상태에서 호출해야 한다.
+static void
+dfree_insert(struct dfree *d)
+{
+  struct dfree **pp;
+
+  for(pp = &dfreeq.head; *pp && (*pp)->expiry <= d->expiry; pp = &(*pp)->next)
+    ;
+  d->next = *pp;
+  *pp = d;
+  dfree_next = dfreeq.head->expiry;
+}
+
+//요청 하나를 큐에서 뺀 뒤 프로세스의 지연 해제 정보를 맞춰준다. ptable.lock을 잡은 상태에서 호출해야 한다.
+static void
+dfree_put(struct dfree *d)
+{
+  struct proc *p = d->proc;
+
+  p->pending_free_pages -= (d->end - d->start) / PGSIZE;
+  if(p->pending_free_pages == 0)
+    p->pending_free_addr = 0;
+  d->next = dfreeq.free;
+  dfreeq.free = d;
+}
+
+//p가 걸어둔 요청을 모두 버린다. exit에서 ptable.lock을 잡은 상태로 호출한다.
+static void
+dfree_cancel(struct proc *p)
+{
+  struct dfree *d, **pp;
+
+  for(pp = &dfreeq.head; (d = *pp) != 0; ){
+    if(d->proc == p){
+      *pp = d->next;
+      dfree_put(d);
+    } else
+      pp = &d->next;
+  }
+  dfree_next = dfreeq.head ? dfreeq.head->expiry : 0;
+}
+
+//타이머 인터럽트마다 cpu 0에서 호출된다. 맨 앞 요청이 만료되었을 때만 reclaim 스레드를 깨운다.
+void
+reclaimtick(void)
+{
+  if(dfree_next != 0 && dfree_next <= ticks)
+    wakeup(&dfreeq);
+}
+
+//[start, end)를 해제한다. 가장 위쪽 구간이 해제되면 그 아래에 먼저 해제된 구간까지 sz를 줄인다.
+//실패하면 0을 반환한다.
+static int
+dfree_apply(struct proc *p, struct dfree *d)
+{
+  uint end = d->end < p->sz ? d->end : p->sz;
+  pte_t *pte;
+
+  if(d->start < end && deallocuvm(p->pgdir, end, d->start) == 0){
+    cprintf("Memory Deallocation fault\n");
+    return 0;
+  }
+  if(end == p->sz && d->start < end){
+    p->sz = d->start;
+    while(p->sz > 0 && (pte = walkpgdir(p->pgdir, (char*)(p->sz - PGSIZE), 0)) != 0 && *pte == 0)
+      p->sz -= PGSIZE;
+  }
+  return 1;
+}
+
+//큐에서 뺀 요청 하나를 해제하고 실행 시간과 메모리 상태를 출력한 뒤 프로세스를 종료시킨다.
+//해제와 출력은 ptable.lock 없이 하므로 p는 dfree_busy로 멈춰 있거나 호출한 프로세스 자신이어야 한다.
+//ptable.lock 없이 호출하고, ptable.lock을 잡은 채로 돌아온다.
+static void
+dfree_run(struct proc *p, struct dfree *d)
+{
+  struct rtcdate curDateTime;
+  int ok;
+
+  if((ok = dfree_apply(p, d)) != 0){
+    // 현재 시간 가져오기
+    cmostime(&curDateTime);
+    //메모리 해제 시간에 대한 정보 출력
+    cprintf("Memory deallocation execute: %d-%d-%d %d:%d:%d\n",
+            curDateTime.year, curDateTime.month, curDateTime.day,
+            curDateTime.hour, curDateTime.minute, curDateTime.second);
+
+    memstat(p);
+  }
+
+  acquire(&ptable.lock);
+  dfree_put(d);
+  // 메모리 해제 후 프로세스 종료
+  p->killed = 1;
+  if(!ok)
+    return;
+  if(p->state == SLEEPING)
+    p->state = RUNNABLE;
+  p->allowDelayTicks = 0;
+  memset(&p->ssusbrk_call_time, 0, sizeof(p->ssusbrk_call_time));
+}
+
+//p가 지금 하고 있는 시스템 콜에 넘긴 버퍼가 d의 구간에 걸쳐 있으면 1을 반환한다.
+static int
+dfree_pinned(struct proc *p, struct dfree *d)
+{
+  int i;
+
+  for(i = 0; i < p->npin; i++)
+    if(p->pin[i].lo < d->end && d->start < p->pin[i].hi)
+      return 1;
+  return 0;
+}
+
+//지연 해제 큐를 비우는 커널 스레드다.
+//scheduler가 ptable.lock을 잡은 채로 넘어오고, 큐를 고칠 때는 잡고 있다가 해제하고 출력하는 동안만 놓는다.
+static void
+reclaimer(void)
+{
+  struct dfree *d;
+  struct proc *p;
+
+  for(;;){
+    while((d = dfreeq.head) == 0 || d->expiry > ticks)
+      sleep(&dfreeq, &ptable.lock);
+    dfreeq.head = d->next;
+    dfree_next = dfreeq.head ? dfreeq.head->expiry : 0;
+    p = d->proc;
+
+    if(p->pid != d->pid || p->pgdir != d->pgdir){
+      // exec로 주소 공간이 바뀌었으면 요청한 구간이 더 이상 의미가 없다.
+      dfree_put(d);
+      continue;
+    }
+    if(p->state == RUNNING || dfree_pinned(p, d)){
+      // 다른 cpu에서 실행 중이면 그 cpu의 TLB에 해제할 페이지가 남아있을 수 있으므로 여기서 해제하지 않는다.
+      // 시스템 콜 안에서 잠들어 있고 그 시스템 콜이 쓰는 버퍼가 걸쳐 있어도 해제하지 않는다.
+      // 프로세스가 사용자 모드로 돌아가기 전에 스스로 해제하도록 표시하고,
+      // 그 전에 잠들면 다음 tick에 여기서 다시 보도록 순서에 맞게 다시 넣는다.
+      d->due = 1;
+      d->expiry = ticks + 1;
+      dfree_insert(d);
+      p->dfree_due = 1;
+      continue;
+    }
+
+    // 해제하고 출력하는 동안 p가 실행되거나 swap으로 내보내지지 않게 표시해두고 ptable.lock을 놓는다.
+    p->dfree_busy = 1;
+    release(&ptable.lock);
+    dfree_run(p, d);
+    p->dfree_busy = 0;
+  }
+}
+
+//reclaim 스레드가 실행 중이라 미뤄둔 요청들을 사용자 모드로 돌아가기 전에 스스로 해제한다.
+void
+dfreecheck(void)
+{
+  struct proc *p = myproc();
+  struct dfree *d, **pp, *due;
+
+  if(p == 0 || !p->dfree_due)
+    return;
+
+  acquire(&ptable.lock);
+  p->dfree_due = 0;
+  due = 0;
+  for(pp = &dfreeq.head; (d = *pp) != 0; ){
+    if(d->proc == p && d->due){
+      *pp = d->next;
+      if(d->pgdir != p->pgdir){
+        dfree_put(d);
+      } else {
+        d->next = due;
+        due = d;
+      }
+    } else
+      pp = &d->next;
+  }
+  dfree_next = dfreeq.head ? dfreeq.head->expiry : 0;
+  release(&ptable.lock);
+
+  while((d = due) != 0){
+    due = d->next;
+    dfree_run(p, d);
+    release(&ptable.lock);
+  }
+}
+
 //memstat함수와 관련된 부분입니다.
 int
 procMemstat(void)
 {
-    //현재 프로세스를 구함
-    struct proc *curproc = myproc();
-    pde_t *pgdir = curproc->pgdir;
-    uint sz = curproc->sz;
+    memstat(myproc());
+    return 0;
+}
 
-    int total_vpages = (sz + PGSIZE - 1) / PGSIZE; // 가상 메모리 페이지 수
-    int total_ppages = 0; // 물리 메모리 페이지 수
+static void
+memstat(struct proc *p)
+{
+    struct memstat st;
 
-    // 페이지 테이블을 순회하며 물리 메모리에 매핑된 페이지 수 계산
-    uint addr;
-    for(addr = 0; addr < sz; addr += PGSIZE){
-        pte_t *pte = walkpgdir(pgdir, (void*)addr, 0);
-        if(pte && (*pte & PTE_P)){
-            total_ppages++;
-        }
-    }
+    // 페이지 수는 매핑이 바뀔 때마다 갱신해 둔 값을 쓴다.
+    // 읽기만 해서 공유 zero 페이지가 매핑된 페이지는 물리 메모리를 따로 쓰지 않으므로 따로 센다.
+    fillmemstat(p, &st);
 
     //vp 와 pp의 값을 출력합니다.
-    cprintf(" vp: %d, pp: %d\n", total_vpages, total_ppages);
+    //지연할당과 swap 페이지 수는 출력하지 않고 getmemstat으로만 돌려준다.
+    cprintf(" vp: %d, pp: %d, zp: %d\n", st.vpages, st.rss, st.zpages);
 
     // PDE와 PTE 값을 출력하는 함수 호출
-    print_pde_pte(pgdir, sz);
+    print_pde_pte(p->pgdir, p->sz);
+}
 
-    return 0;
+//p의 메모리 사용량을 st에 채운다. 페이지 테이블을 훑지 않고 콘솔에도 출력하지 않는다.
+void
+fillmemstat(struct proc *p, struct memstat *st)
+{
+    struct vma *v;
+
+    vmstat(p->pgdir, st);
+    st->vpages = (p->sz + PGSIZE - 1) / PGSIZE;
+    for(v = p->vma; v < &p->vma[NVMA]; v++)
+      if(v->end != 0)
+        st->vpages += (v->end - v->start) / PGSIZE;
+    st->pending = p->pending_free_pages;
 }
 
 void
@@ -662,6 +997,11 @@ print_pde_pte(pde_t *pgdir, uint sz)
         if(pgdir[i] & PTE_P){
             pde_found = 1;
             cprintf(" PDE - 0x%x\n", pgdir[i]);
+            if(pgdir[i] & PTE_PS){
+              //4MB 페이지는 페이지 테이블 없이 PDE가 직접 물리 메모리를 가리킨다.
+              cprintf(" PTE - 4MB page\n");
+              continue;
+            }
 
             pte_t *pgtab = (pte_t*)P2V(PTE_ADDR(pgdir[i]));
 
@@ -686,4 +1026,4 @@ print_pde_pte(pde_t *pgdir, uint sz)
             cprintf("\n");
         }
     }
-}
\ No newline at end of file
+}
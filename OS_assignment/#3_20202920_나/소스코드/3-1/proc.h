@@ -1,4 +1,5 @@
 #include "date.h"
+#include "mman.h"
 
 // Per-CPU state
 struct cpu {
@@ -10,6 +11,8 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  pde_t *pgdir;                // cr3에 올라가 있는 사용자 페이지 테이블, 0이면 커널 페이지 테이블
+  uint tlbgen;                 // pgdir을 올리거나 비울 때의 vmspace tlbgen, 다르면 TLB에 지워진 PTE가 남아있을 수 있다.
 };
 
 extern struct cpu cpus[NCPU];
@@ -34,6 +37,38 @@ struct context {
   uint eip;
 };
 
+// exec가 기록해 두는 실행 파일 구간 하나. [va, va+filesz)는 ip의 off부터 읽어서 채운다.
+struct fmap {
+  struct inode *ip;            // 0이면 빈 항목
+  uint va;
+  uint filesz;
+  uint off;
+};
+
+// 한 프로세스가 가질 수 있는 실행 파일 구간 수, 넘치는 세그먼트는 exec에서 바로 읽어온다.
+#define NFMAP 4
+
+// mmap으로 만든 영역 하나. [start, end)는 f가 0이면 익명 메모리, 아니면 f의 off부터 읽어온 내용이다.
+struct vma {
+  uint start;
+  uint end;                    // 0이면 빈 항목
+  int prot;                    // PROT_READ, PROT_WRITE
+  struct file *f;
+  uint off;
+  struct shm *shm;             // shmat으로 붙인 공유 메모리면 그 segment
+};
+
+// 한 프로세스가 가질 수 있는 mmap 영역 수
+#define NVMA 16
+
+// 시스템 콜 하나가 argptr로 넘겨받을 수 있는 사용자 버퍼 수
+#define NPIN 4
+
+struct pin {
+  uint lo;
+  uint hi;
+};
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -53,12 +88,30 @@ struct proc {
   char name[16];               // Process name (debugging)
   // 지연 메모리 해제를 위한 변수들
   int allowDelayTicks;       // 적용시킨 tick수
-  int pending_free_ticks;    // 남은 tick 수
-  int pending_free_pages;    // 지연 해제할 페이지 수
-  uint pending_free_addr;    // 해제할 메모리 시작 주소
+  int pending_free_pages;    // 지연 해제 큐에 걸려있는 페이지 수
+  uint pending_free_addr;    // 지연 해제 요청들이 차지한 가장 낮은 주소, 없으면 0
+  int dfree_busy;            // reclaim 스레드가 해제하는 중이라 실행하거나 swap으로 내보내지 않는다.
+  int dfree_due;             // 실행 중이라 reclaim 스레드가 미뤄둔 요청이 있다. 사용자 모드로 돌아가기 전에 스스로 해제한다.
   struct rtcdate ssusbrk_call_time;   // ssusbrk() 호출 시의 시간
+  // fault-around를 위한 변수들
+  uint fault_next;           // 지난 폴트에서 미리 매핑한 구간의 바로 다음 주소
+  int fault_seq;             // 연속으로 순차 폴트가 난 횟수
+  struct fmap fmap[NFMAP];   // 처음 접근할 때 실행 파일에서 읽어올 구간들
+  struct pin pin[NPIN];      // 시스템 콜이 커널에 넘긴 사용자 버퍼들, swap으로 내보내지 않는다.
+  int npin;
+  struct vma vma[NVMA];      // mmap으로 만든 영역들, KERNBASE 아래에서부터 채운다.
+  struct proc *next;         // ptable의 프로세스 list
+  struct faultstat fst;      // 이 프로세스의 페이지 폴트 통계
 };
 
+// 지연할당 영역에서 순차 폴트가 FAULTAROUND_START번 이어지면 그 다음부터 이웃한 페이지를 미리 매핑한다.
+// 미리 매핑하는 페이지 수는 폴트마다 두 배로 늘어나며 FAULTAROUND_MAX를 넘지 않는다.
+#define FAULTAROUND_START 4
+#define FAULTAROUND_MAX   32
+
+// 시스템 전체에서 동시에 걸어둘 수 있는 지연 해제 요청 수
+#define NDFREE (NPROC*4)
+
 // Process memory is laid out contiguously, low addresses first:
 //   text
 //   original data and bss
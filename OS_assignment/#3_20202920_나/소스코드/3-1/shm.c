@@ -0,0 +1,221 @@
+// System V 스타일의 공유 메모리 segment.
+// shmget으로 만든 segment는 물리 페이지 목록을 들고 있고, shmat은 그 페이지들을 VMA 하나에 그대로 매핑한다.
+// 물리 페이지마다 segment가 참조 하나를, 붙어있는 pgdir이 매핑마다 참조 하나를 가지므로
+// shmdt나 exit(freevm)로 매핑을 지우면 kfree가 참조만 줄이고, 페이지는 segment가 없어질 때 해제된다.
+// 붙어있는 페이지는 참조가 2 이상이라 swap으로 내보내지 않는다.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "mman.h"
+
+struct shm {
+  int used;
+  int busy;                   // shmget이 페이지를 할당하는 중
+  int removed;                // IPC_RMID를 받아서 마지막 shmdt 때 없어진다.
+  int key;
+  int nattach;                // 이 segment를 매핑한 VMA 수
+  uint npages;
+  char *pages[SHMMAXPAGES];
+};
+
+struct {
+  struct spinlock lock;
+  struct shm seg[NSHM];
+} shmtable;
+
+void
+shminit(void)
+{
+  initlock(&shmtable.lock, "shm");
+}
+
+// segment의 페이지를 모두 해제하고 항목을 비운다. shmtable.lock을 잡은 상태에서 호출해야 한다.
+static void
+shmfree(struct shm *s)
+{
+  uint i;
+
+  for(i = 0; i < s->npages; i++)
+    if(s->pages[i])
+      kfree(s->pages[i]);
+  memset(s, 0, sizeof(*s));
+}
+
+// key에 해당하는 segment의 번호를 돌려준다. 없고 IPC_CREAT이 있으면 size 바이트로 새로 만든다.
+// key가 IPC_PRIVATE이면 항상 새로 만든다.
+int
+shmget(int key, int size, int flag)
+{
+  struct shm *s;
+  int i;
+  uint npages;
+
+  if(size <= 0 || (npages = PGROUNDUP(size) / PGSIZE) > SHMMAXPAGES)
+    return -1;
+
+  acquire(&shmtable.lock);
+again:
+  if(key != IPC_PRIVATE){
+    for(s = shmtable.seg; s < &shmtable.seg[NSHM]; s++){
+      if(!s->used || s->removed || s->key != key)
+        continue;
+      if(s->busy){
+        //다른 프로세스가 같은 key로 만드는 중이면 끝날 때까지 기다렸다가 다시 찾는다.
+        sleep(s, &shmtable.lock);
+        goto again;
+      }
+      i = npages <= s->npages ? s - shmtable.seg : -1;
+      release(&shmtable.lock);
+      return i;
+    }
+    if(!(flag & IPC_CREAT)){
+      release(&shmtable.lock);
+      return -1;
+    }
+  }
+  for(s = shmtable.seg; s < &shmtable.seg[NSHM] && s->used; s++)
+    ;
+  if(s == &shmtable.seg[NSHM]){
+    release(&shmtable.lock);
+    return -1;
+  }
+  s->used = 1;
+  s->busy = 1;
+  s->key = key;
+  s->npages = npages;
+  release(&shmtable.lock);
+
+  //페이지 할당은 swap으로 내보내면서 잠들 수 있으므로 락 없이 한다. busy인 동안은 아무도 이 항목을 건드리지 않는다.
+  for(i = 0; i < npages; i++)
+    if((s->pages[i] = uvmkalloc(1)) == 0)
+      break;
+
+  acquire(&shmtable.lock);
+  s->busy = 0;
+  wakeup(s);
+  if(i < npages){
+    cprintf("Out of physical memory.\n");
+    shmfree(s);
+    release(&shmtable.lock);
+    return -1;
+  }
+  release(&shmtable.lock);
+  return s - shmtable.seg;
+}
+
+// v가 가리키는 segment의 페이지들을 pgdir의 v 구간에 매핑한다. 매핑마다 페이지 참조를 하나씩 늘린다.
+int
+shmmap(pde_t *pgdir, struct vma *v)
+{
+  uint i;
+  int perm;
+
+  perm = PTE_U;
+  if(v->prot & PROT_WRITE)
+    perm |= PTE_W;
+  for(i = 0; i < v->shm->npages; i++){
+    if(mappages(pgdir, (char*)v->start + i*PGSIZE, PGSIZE, V2P(v->shm->pages[i]), perm) < 0)
+      return -1;
+    kincref(v->shm->pages[i]);
+  }
+  return 0;
+}
+
+// segment에 붙는 VMA가 하나 늘었다.
+void
+shmhold(struct shm *s)
+{
+  acquire(&shmtable.lock);
+  s->nattach++;
+  release(&shmtable.lock);
+}
+
+// segment에서 VMA 하나가 떨어졌다. IPC_RMID를 받은 segment면 마지막으로 떨어질 때 해제한다.
+void
+shmdrop(struct shm *s)
+{
+  acquire(&shmtable.lock);
+  if(--s->nattach == 0 && s->removed)
+    shmfree(s);
+  release(&shmtable.lock);
+}
+
+// id번 segment를 현재 프로세스의 빈 구간에 붙이고 시작 주소를 반환한다.
+// SHM_RDONLY면 읽기만 할 수 있게 매핑한다.
+int
+shmat(int id, int flag)
+{
+  struct proc *curproc = myproc();
+  struct shm *s;
+  struct vma *v;
+
+  if(id < 0 || id >= NSHM)
+    return -1;
+  s = &shmtable.seg[id];
+  acquire(&shmtable.lock);
+  if(!s->used || s->busy || s->removed){
+    release(&shmtable.lock);
+    return -1;
+  }
+  s->nattach++;
+  release(&shmtable.lock);
+
+  if((v = vmaalloc(curproc, s->npages * PGSIZE)) == 0){
+    shmdrop(s);
+    return -1;
+  }
+  v->prot = PROT_READ;
+  if(!(flag & SHM_RDONLY))
+    v->prot |= PROT_WRITE;
+  v->shm = s;
+  if(shmmap(curproc->pgdir, v) < 0){
+    shmdt(v->start);
+    return -1;
+  }
+  return v->start;
+}
+
+// addr에 붙어있는 segment를 현재 프로세스에서 뗀다.
+int
+shmdt(uint addr)
+{
+  struct proc *curproc = myproc();
+  struct vma *v;
+  struct shm *s;
+
+  if((v = findvma(curproc, addr)) == 0 || v->start != addr || v->shm == 0)
+    return -1;
+  //매핑을 지우면서 페이지 참조를 하나씩 줄인다. 페이지는 segment가 들고 있으므로 해제되지 않는다.
+  deallocuvm(curproc->pgdir, v->end, v->start);
+  s = v->shm;
+  memset(v, 0, sizeof(*v));
+  shmdrop(s);
+  return 0;
+}
+
+// IPC_RMID만 지원한다. 더 이상 shmget으로 찾거나 shmat으로 붙일 수 없게 하고,
+// 붙어있는 프로세스가 없으면 바로, 있으면 마지막 shmdt 때 해제한다.
+int
+shmctl(int id, int cmd)
+{
+  struct shm *s;
+
+  if(id < 0 || id >= NSHM || cmd != IPC_RMID)
+    return -1;
+  s = &shmtable.seg[id];
+  acquire(&shmtable.lock);
+  if(!s->used || s->busy || s->removed){
+    release(&shmtable.lock);
+    return -1;
+  }
+  s->removed = 1;
+  if(s->nattach == 0)
+    shmfree(s);
+  release(&shmtable.lock);
+  return 0;
+}
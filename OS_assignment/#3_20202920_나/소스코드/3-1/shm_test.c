@@ -0,0 +1,64 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "mman.h"
+
+#define SHMSIZE (4096 * 8)
+
+void _error(const char *msg) {
+    printf(1, "%s\nshm_test failed...\n", msg);
+    exit();
+}
+
+int main() {
+    int id, i, fd[2];
+    char *buf, *ro, c;
+
+    printf(1, "### Shm test start\n");
+
+    if ((id = shmget(IPC_PRIVATE, SHMSIZE, IPC_CREAT)) < 0)
+        _error("shmget error");
+    if ((int)(buf = shmat(id, 0, 0)) < 0)
+        _error("shmat error");
+    if (buf[0] != 0 || buf[SHMSIZE - 1] != 0)
+        _error("segment not zero");
+
+    // 자식이 쓴 내용이 복사 없이 부모에게 보인다. pipe로는 다 썼다는 신호만 보낸다.
+    if (pipe(fd) < 0)
+        _error("pipe error");
+    if (fork() == 0) {
+        for (i = 0; i < SHMSIZE; i += 4096)
+            buf[i] = 'a' + i / 4096;
+        write(fd[1], "x", 1);
+        exit();
+    }
+    if (read(fd[0], &c, 1) != 1)
+        _error("pipe read error");
+    wait();
+    for (i = 0; i < SHMSIZE; i += 4096)
+        if (buf[i] != 'a' + i / 4096)
+            _error("shared write not visible");
+
+    // 다른 주소에 한 번 더 붙여도 같은 페이지가 보인다.
+    if ((int)(ro = shmat(id, 0, SHM_RDONLY)) < 0 || ro == buf)
+        _error("second shmat error");
+    if (ro[4096] != 'b')
+        _error("second mapping differs");
+
+    // 떼어낸 뒤에도 segment는 남아있고, IPC_RMID 뒤 마지막 shmdt에서 해제된다.
+    if (shmdt(ro) < 0)
+        _error("shmdt error");
+    if (shmdt(ro) == 0)
+        _error("double shmdt succeeded");
+    if (shmctl(id, IPC_RMID) < 0)
+        _error("shmctl error");
+    if (shmat(id, 0, 0) != (void *)-1)
+        _error("shmat after IPC_RMID succeeded");
+    if (buf[0] != 'a')
+        _error("segment freed while attached");
+    if (shmdt(buf) < 0)
+        _error("last shmdt error");
+
+    printf(1, "### Shm test passed...\n");
+    exit();
+}
@@ -0,0 +1,153 @@
+// 작은 커널 객체(struct proc, struct file, pipe)를 위한 slab 할당기.
+// 페이지 하나를 slab으로 쓰며 맨 앞에 struct slab을 두고 나머지를 같은 크기의 객체로 나눈다.
+// 객체로 slab을 찾을 때는 페이지 경계로 내리기만 하면 된다.
+// 각 객체 뒤에는 free list를 잇는 포인터 자리를 따로 두어서 ctor로 초기화한 내용이 해제 후에도 남게 한다.
+// 자주 쓰는 할당과 해제는 cpu별 캐시에서 락 없이 처리하고, 비거나 넘칠 때만 캐시 락을 잡는다.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "slab.h"
+
+struct slab {
+  struct slabcache *cache;
+  struct slab *next;          // cache->partial list
+  char *free;                 // 이 slab의 빈 객체 list
+  uint inuse;                 // 이 slab에서 나간 객체 수
+};
+
+#define SLAB_FIRST   ((sizeof(struct slab) + 3) & ~3)   // 첫 객체의 위치
+#define SLOT(c)      ((c)->size + sizeof(char*))        // 객체 하나가 차지하는 크기
+#define NEXTFREE(c, o) (*(char**)((o) + (c)->size))     // 객체 뒤의 free list 포인터
+
+void
+slabinit(struct slabcache *c, char *name, uint size, void (*ctor)(void*))
+{
+  memset(c, 0, sizeof(*c));
+  c->name = name;
+  c->size = (size + 3) & ~3;
+  c->perslab = (PGSIZE - SLAB_FIRST) / SLOT(c);
+  if(c->perslab == 0)
+    panic("slabinit: too big");
+  c->ctor = ctor;
+  initlock(&c->lock, name);
+}
+
+// 새 페이지를 받아서 slab을 만들고 모든 객체를 ctor로 초기화한다. c->lock을 잡은 상태에서 호출해야 한다.
+static struct slab*
+slabgrow(struct slabcache *c)
+{
+  struct slab *s;
+  char *o;
+  uint i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->free = 0;
+  for(i = c->perslab; i-- > 0; ){
+    o = (char*)s + SLAB_FIRST + i*SLOT(c);
+    if(c->ctor)
+      c->ctor(o);
+    else
+      memset(o, 0, c->size);
+    NEXTFREE(c, o) = s->free;
+    s->free = o;
+  }
+  s->next = c->partial;
+  c->partial = s;
+  c->nslab++;
+  return s;
+}
+
+// slab에서 객체 하나를 꺼낸다. c->lock을 잡은 상태에서 호출해야 한다.
+static char*
+slabget(struct slabcache *c)
+{
+  struct slab *s;
+  char *o;
+
+  if((s = c->partial) == 0 && (s = slabgrow(c)) == 0)
+    return 0;
+  o = s->free;
+  s->free = NEXTFREE(c, o);
+  s->inuse++;
+  if(s->free == 0)
+    c->partial = s->next;   // 꽉 찬 slab은 list에서 뺀다.
+  return o;
+}
+
+// 객체를 slab으로 돌려준다. c->lock을 잡은 상태에서 호출해야 한다.
+// slab이 통째로 비면 페이지를 돌려주되, 다음 할당을 위해 마지막 slab 하나는 남겨둔다.
+static void
+slabput(struct slabcache *c, char *o)
+{
+  struct slab *s, **pp;
+
+  s = (struct slab*)PGROUNDDOWN((uint)o);
+  if(s->cache != c)
+    panic("slabput");
+  if(s->free == 0){
+    s->next = c->partial;
+    c->partial = s;
+  }
+  NEXTFREE(c, o) = s->free;
+  s->free = o;
+  if(--s->inuse > 0 || c->nslab == 1)
+    return;
+  for(pp = &c->partial; *pp != s; pp = &(*pp)->next)
+    ;
+  *pp = s->next;
+  c->nslab--;
+  kfree((char*)s);
+}
+
+// 객체 하나를 할당한다. ctor로 초기화된 상태이거나 slabfree로 돌려받은 상태 그대로다.
+// 메모리가 없으면 0을 반환한다.
+void*
+slaballoc(struct slabcache *c)
+{
+  char *o;
+  int i;
+
+  pushcli();
+  i = cpuid();
+  if(c->cpu[i].n == 0){
+    //cpu 캐시가 비었으면 slab에서 SLAB_BATCH개를 한꺼번에 가져온다.
+    acquire(&c->lock);
+    while(c->cpu[i].n < SLAB_BATCH && (o = slabget(c)) != 0)
+      c->cpu[i].obj[c->cpu[i].n++] = o;
+    c->ninuse += c->cpu[i].n;
+    release(&c->lock);
+  }
+  o = 0;
+  if(c->cpu[i].n > 0)
+    o = c->cpu[i].obj[--c->cpu[i].n];
+  popcli();
+  return o;
+}
+
+// 객체를 돌려준다. 다음에 꺼내 쓸 수 있도록 ctor가 만든 상태로 되돌려 놓고 불러야 한다.
+void
+slabfree(struct slabcache *c, void *o)
+{
+  int i;
+
+  pushcli();
+  i = cpuid();
+  if(c->cpu[i].n == SLAB_CPUCACHE){
+    //cpu 캐시가 넘치면 SLAB_BATCH개를 slab으로 돌려준다.
+    acquire(&c->lock);
+    while(c->cpu[i].n > SLAB_CPUCACHE - SLAB_BATCH){
+      slabput(c, c->cpu[i].obj[--c->cpu[i].n]);
+      c->ninuse--;
+    }
+    release(&c->lock);
+  }
+  c->cpu[i].obj[c->cpu[i].n++] = o;
+  popcli();
+}
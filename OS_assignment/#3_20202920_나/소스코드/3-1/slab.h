@@ -0,0 +1,21 @@
+// 같은 크기의 커널 객체를 모아두는 slab 캐시.
+// 한 페이지를 slab 하나로 써서 여러 객체를 나눠 담고, 처음 페이지를 받아올 때 ctor로 객체를 초기화해 둔다.
+// 해제된 객체는 초기화된 상태로 돌려받는다고 가정하므로 다시 꺼낼 때 ctor를 부르지 않는다.
+
+#define SLAB_CPUCACHE 8   // cpu마다 락 없이 들고 있는 객체 수의 상한
+#define SLAB_BATCH    4   // cpu 캐시와 slab 사이에 한 번에 옮기는 객체 수
+
+struct slabcache {
+  char *name;
+  uint size;                  // 객체 크기, 뒤에 free list 연결용 포인터 하나가 더 붙는다.
+  uint perslab;               // slab 하나에 들어가는 객체 수
+  void (*ctor)(void*);        // 새 slab의 객체를 초기화하는 함수, 0이면 0으로 채운다.
+  struct spinlock lock;
+  struct slab *partial;       // 빈 객체가 남아있는 slab들
+  uint nslab;                 // 가지고 있는 slab(페이지) 수
+  uint ninuse;                // 할당되어 있는 객체 수 (cpu 캐시에 있는 것 포함)
+  struct {
+    void *obj[SLAB_CPUCACHE];
+    int n;
+  } cpu[NCPU];
+};
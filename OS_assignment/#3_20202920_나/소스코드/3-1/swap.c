@@ -0,0 +1,250 @@
+// 물리 메모리가 모자랄 때 사용자 페이지를 fs.img 뒤쪽의 swap 영역으로 내보낸다.
+// 내보낼 페이지는 모든 프로세스의 PTE를 도는 clock(second-chance) 알고리즘으로 고르고,
+// 내보낸 페이지에 다시 접근하면 pgfault에서 읽어온다.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "mman.h"
+
+//ptable 가져오기
+extern struct {
+  struct spinlock lock;
+  struct proc *head;
+  int nproc;
+} ptable;
+
+#define SWAPSTART FSSIZE           // swap 영역의 첫 블록, 파일 시스템 바로 뒤에 있다.
+#define BPP       (PGSIZE/BSIZE)   // 페이지 하나가 차지하는 블록 수
+
+// 락 순서는 ptable.lock -> swap.lock 이다. wait가 ptable.lock을 잡은 채로 freevm에서 swapfree를 부른다.
+struct {
+  struct spinlock lock;
+  ushort ref[SWAPPAGES];   // slot을 가리키는 PTE 수, 0이면 비어있다. fork로 PTE가 복사되면 늘어난다.
+  uchar busy[SWAPPAGES];   // 아직 디스크에 쓰고 있는 slot, 읽으려면 끝날 때까지 기다린다.
+  int hand;                // clock 바늘이 가리키는 프로세스의 ptable list 안에서의 순서
+  uint handva;             // 그 프로세스에서 다음에 볼 주소
+  struct swapstat st;
+} swap;
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+  swap.st.nslot = SWAPPAGES;
+  swap.st.nfree = SWAPPAGES;
+}
+
+// slot 하나를 블록 단위로 읽거나 쓴다. 버퍼 캐시를 거치지 않고 디스크에 바로 요청한다.
+static void
+swaprw(int slot, char *pg, int write)
+{
+  struct buf b;
+  int i;
+
+  memset(&b, 0, sizeof(b));
+  initsleeplock(&b.lock, "swapbuf");
+  acquiresleep(&b.lock);
+  b.dev = ROOTDEV;
+  for(i = 0; i < BPP; i++){
+    b.blockno = SWAPSTART + slot*BPP + i;
+    if(write){
+      memmove(b.data, pg + i*BSIZE, BSIZE);
+      b.flags = B_DIRTY;
+    } else
+      b.flags = 0;
+    iderw(&b);
+    if(!write)
+      memmove(pg + i*BSIZE, b.data, BSIZE);
+  }
+  releasesleep(&b.lock);
+}
+
+// va가 시스템 콜이 쓰고 있는 p의 버퍼 안이면 1을 반환한다.
+static int
+pinned(struct proc *p, uint va)
+{
+  int i;
+
+  for(i = 0; i < p->npin; i++)
+    if(va >= PGROUNDDOWN(p->pin[i].lo) && va < p->pin[i].hi)
+      return 1;
+  return 0;
+}
+
+// p의 페이지를 swap으로 내보내도 되는지 확인한다. ptable.lock을 잡은 상태에서 호출해야 한다.
+// 다른 cpu에서 실행 중인 프로세스는 그 cpu의 TLB를 비울 수 없으므로 건너뛴다.
+// reclaim 스레드가 락 없이 주소 공간을 해제하고 있는 프로세스도 건너뛴다.
+static int
+evictable(struct proc *p)
+{
+  if(p->pgdir == 0 || p->sz == 0 || p->dfree_busy)
+    return 0;
+  if(p->state == SLEEPING || p->state == RUNNABLE)
+    return 1;
+  return p->state == RUNNING && p == myproc();
+}
+
+// clock 바늘을 돌려서 내보낼 페이지를 고른다. ptable.lock을 잡은 상태에서 호출해야 한다.
+// 힙 위쪽의 mmap 영역도 보도록 KERNBASE까지 돈다. 페이지 테이블이 없는 곳은 4MB씩 건너뛴다.
+// 최근에 접근한(PTE_A) 페이지는 A 비트만 지우고 한 번 더 기회를 준다.
+// 공유 zero 페이지, copy-on-write로 공유 중인 페이지, 4MB 페이지, 시스템 콜이 쓰고 있는 버퍼는 고르지 않는다.
+static pte_t*
+pickvictim(struct proc **pp)
+{
+  struct proc *p;
+  pte_t *pte;
+  int i, n, flush;
+
+  for(n = 0; n < 2*ptable.nproc+1; n++){
+    //프로세스는 list로 이어져 있으므로 바늘의 순서만큼 따라간다. 그 사이 프로세스가 줄었으면 처음으로 돌아간다.
+    for(p = ptable.head, i = 0; p && i < swap.hand; p = p->next, i++)
+      ;
+    if(p == 0){
+      swap.hand = 0;
+      swap.handva = 0;
+      continue;
+    }
+    flush = 0;
+    if(evictable(p)){
+      for(; swap.handva < KERNBASE; swap.handva += PGSIZE){
+        if((p->pgdir[PDX(swap.handva)] & (PTE_P|PTE_PS)) != PTE_P){
+          swap.handva = PGADDR(PDX(swap.handva) + 1, 0, 0) - PGSIZE;
+          continue;
+        }
+        pte = walkpgdir(p->pgdir, (char*)swap.handva, 0);
+        swap.st.nscan++;
+        if((*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U) || P2V(PTE_ADDR(*pte)) == zeropage)
+          continue;
+        if(pinned(p, swap.handva))
+          continue;
+        if(*pte & PTE_A){
+          *pte &= ~PTE_A;
+          flush = 1;
+          continue;
+        }
+        if(krefcount(P2V(PTE_ADDR(*pte))) != 1)
+          continue;
+        *pp = p;
+        swap.handva += PGSIZE;
+        return pte;
+      }
+      //TLB에 A 비트가 켜진 채로 남아있으면 다시 접근해도 A 비트가 켜지지 않는다.
+      if(flush)
+        tlbflush(p->pgdir);
+    }
+    swap.hand++;
+    swap.handva = 0;
+  }
+  return 0;
+}
+
+// 사용자 페이지 하나를 swap 영역으로 내보내고 물리 메모리를 돌려준다.
+// 내보낼 페이지가 없거나, swap이 가득 찼거나, 스핀락을 잡고 있어서 디스크를 기다릴 수 없으면 -1을 반환한다.
+int
+swapout(void)
+{
+  struct proc *p;
+  pte_t *pte;
+  char *pg;
+  int slot, locked;
+
+  pushcli();
+  locked = mycpu()->ncli > 1;
+  popcli();
+  if(locked)
+    return -1;
+
+  // slot을 먼저 잡아둔다. 디스크에 다 쓸 때까지 busy로 표시해서 읽는 쪽이 기다리게 한다.
+  acquire(&swap.lock);
+  for(slot = 0; slot < SWAPPAGES && (swap.ref[slot] != 0 || swap.busy[slot]); slot++)
+    ;
+  if(slot == SWAPPAGES){
+    release(&swap.lock);
+    return -1;
+  }
+  swap.ref[slot] = 1;
+  swap.busy[slot] = 1;
+  swap.st.nfree--;
+  release(&swap.lock);
+
+  acquire(&ptable.lock);
+  if((pte = pickvictim(&p)) == 0){
+    release(&ptable.lock);
+    acquire(&swap.lock);
+    swap.ref[slot] = 0;
+    swap.busy[slot] = 0;
+    swap.st.nfree++;
+    release(&swap.lock);
+    return -1;
+  }
+  pg = P2V(uvmevict(p->pgdir, pte, slot));
+  //pickvictim이 바늘을 고른 페이지 다음으로 옮겨 두었다.
+  tlbinval(p->pgdir, swap.handva - PGSIZE);
+  release(&ptable.lock);
+
+  swaprw(slot, pg, 1);
+  kfree(pg);
+
+  acquire(&swap.lock);
+  swap.busy[slot] = 0;
+  swap.st.nswapout++;
+  release(&swap.lock);
+  wakeup(&swap.busy[slot]);
+  return 0;
+}
+
+// slot의 내용을 pg로 읽어온다. 아직 내보내는 중이면 끝날 때까지 기다린다.
+// slot의 참조는 줄이지 않으며, 호출한 쪽이 PTE를 바꾼 뒤 swapfree를 부른다.
+// busy는 swap.lock으로 바꾸지만, 락 순서 때문에 기다릴 때는 ptable.lock으로 sleep한다.
+// wakeup이 ptable.lock을 잡으므로 확인한 뒤 잠들기 전에 깨우는 것을 놓치지 않는다.
+void
+swapin(int slot, char *pg)
+{
+  acquire(&ptable.lock);
+  while(swap.busy[slot])
+    sleep(&swap.busy[slot], &ptable.lock);
+  release(&ptable.lock);
+
+  swaprw(slot, pg, 0);
+
+  acquire(&swap.lock);
+  swap.st.nswapin++;
+  release(&swap.lock);
+}
+
+// fork로 swap PTE가 복사되면 slot의 참조 수를 올린다.
+void
+swapdup(int slot)
+{
+  acquire(&swap.lock);
+  swap.ref[slot]++;
+  release(&swap.lock);
+}
+
+// swap PTE가 없어질 때 slot의 참조 수를 줄이고, 0이 되면 slot을 비운다.
+void
+swapfree(int slot)
+{
+  acquire(&swap.lock);
+  if(swap.ref[slot] == 0)
+    panic("swapfree");
+  if(--swap.ref[slot] == 0)
+    swap.st.nfree++;
+  release(&swap.lock);
+}
+
+void
+getswapstat(struct swapstat *st)
+{
+  acquire(&swap.lock);
+  *st = swap.st;
+  release(&swap.lock);
+}
@@ -21,6 +21,8 @@ fetchint(uint addr, int *ip)
 
   if(addr >= curproc->sz || addr+4 > curproc->sz)
     return -1;
+  if(uvmprefault(curproc, addr, 4, 0) < 0)
+    return -1;
   *ip = *(int*)(addr);
   return 0;
 }
@@ -39,12 +41,26 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    //페이지가 바뀔 때마다 미리 매핑해서 커널이 문자열을 읽다가 폴트가 나지 않게 한다.
+    if((s == *pp || (uint)s % PGSIZE == 0) && uvmprefault(curproc, (uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
   return -1;
 }
 
+// [lo, hi)를 시스템 콜이 끝날 때까지 swap으로 내보내거나 지연 해제하지 않도록 표시한다.
+static void
+pin(struct proc *p, uint lo, uint hi)
+{
+  if(p->npin == NPIN)
+    panic("argptr: too many buffers");
+  p->pin[p->npin].lo = lo;
+  p->pin[p->npin].hi = hi;
+  p->npin++;
+}
+
 // Fetch the nth 32-bit system call argument.
 int
 argint(int n, int *ip)
@@ -55,15 +71,23 @@ argint(int n, int *ip)
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
 // lies within the process address space.
+// 커널이 그 버퍼에 쓸 것이면 write를 1로, 읽기만 할 것이면 0으로 넘긴다.
 int
-argptr(int n, char **pp, int size)
+argptr(int n, char **pp, int size, int write)
 {
   int i;
   struct proc *curproc = myproc();
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0 || vmacheck(curproc, i, size) < 0)
+    return -1;
+  //커널이 이 버퍼를 쓰는 동안 swap으로 내보내거나 지연 해제하지 않도록 표시해 두고,
+  //아직 실행 파일에서 읽어오지 않았거나 swap으로 내보낸 페이지는 여기서 미리 읽어오고, 쓸 버퍼면 쓸 수 있게 만들어 둔다.
+  //한 시스템 콜의 버퍼들은 모두 시스템 콜이 끝날 때까지 표시해 둔다.
+  //미리 매핑하지 못하면 시스템 콜을 실패시켜서, 커널이 버퍼를 쓰다가 폴트로 죽는 일이 없게 한다.
+  pin(curproc, i, i + size);
+  if(uvmprefault(curproc, i, size, write) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
@@ -76,10 +100,13 @@ argptr(int n, char **pp, int size)
 int
 argstr(int n, char **pp)
 {
-  int addr;
+  int addr, len;
   if(argint(n, &addr) < 0)
     return -1;
-  return fetchstr(addr, pp);
+  if((len = fetchstr(addr, pp)) < 0)
+    return -1;
+  pin(myproc(), addr, addr + len + 1);
+  return len;
 }
 
 extern int sys_chdir(void);
@@ -105,6 +132,16 @@ extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_ssusbrk(void);
 extern int sys_memstat(void);
+extern int sys_getmemstat(void);
+extern int sys_getswapstat(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_getbuddystat(void);
+extern int sys_getfaultstat(void);
+extern int sys_shmget(void);
+extern int sys_shmat(void);
+extern int sys_shmdt(void);
+extern int sys_shmctl(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -130,6 +167,16 @@ static int (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_ssusbrk] sys_ssusbrk,
 [SYS_memstat] sys_memstat,
+[SYS_getmemstat] sys_getmemstat,
+[SYS_getswapstat] sys_getswapstat,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_getbuddystat] sys_getbuddystat,
+[SYS_getfaultstat] sys_getfaultstat,
+[SYS_shmget]  sys_shmget,
+[SYS_shmat]   sys_shmat,
+[SYS_shmdt]   sys_shmdt,
+[SYS_shmctl]  sys_shmctl,
 };
 
 void
@@ -141,6 +188,7 @@ syscall(void)
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     curproc->tf->eax = syscalls[num]();
+    curproc->npin = 0;
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
@@ -22,3 +22,13 @@
 #define SYS_close  21
 #define SYS_ssusbrk 22
 #define SYS_memstat 23
+#define SYS_getmemstat 24
+#define SYS_getswapstat 25
+#define SYS_mmap 26
+#define SYS_munmap 27
+#define SYS_getbuddystat 28
+#define SYS_getfaultstat 29
+#define SYS_shmget 30
+#define SYS_shmat 31
+#define SYS_shmdt 32
+#define SYS_shmctl 33
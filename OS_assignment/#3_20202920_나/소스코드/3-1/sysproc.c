@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "mman.h"
 
 int
 sys_fork(void)
@@ -103,8 +104,10 @@ sys_ssusbrk(void){
 
   if(pageSize > 0){
     //메모리를 지연할당하는 경우
-    argint(1,&delayTicks);
-    return ssusbrkAlloc(pageSize);
+    //할당할 때는 두 번째 인자가 지연 tick으로 쓰이지 않으므로 양수이면 mman.h의 플래그로 본다.
+    if(argint(1,&delayTicks) < 0 || delayTicks < 0)
+      delayTicks = 0;
+    return ssusbrkAlloc(pageSize, delayTicks);
   }else if(pageSize < 0){
     //메모리를 지연해제하는 경우
     if(argint(1,&delayTicks)<0)
@@ -121,4 +124,122 @@ sys_ssusbrk(void){
 int
 sys_memstat(void){
   return procMemstat();
-}
\ No newline at end of file
+}
+
+//getmemstat함수의 구현부
+//memstat과 같은 값을 출력하지 않고 사용자가 넘긴 구조체에 채워준다.
+int
+sys_getmemstat(void){
+  struct memstat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st), 1) < 0)
+    return -1;
+  fillmemstat(myproc(), st);
+  return 0;
+}
+
+//getswapstat함수의 구현부
+int
+sys_getswapstat(void){
+  struct swapstat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st), 1) < 0)
+    return -1;
+  getswapstat(st);
+  return 0;
+}
+//getbuddystat함수의 구현부
+int
+sys_getbuddystat(void){
+  struct buddystat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st), 1) < 0)
+    return -1;
+  getbuddystat(st);
+  return 0;
+}
+
+//getfaultstat함수의 구현부
+//첫 번째 인자에는 현재 프로세스의 페이지 폴트 통계를, 두 번째 인자에는 시스템 전체의 통계를 채운다.
+int
+sys_getfaultstat(void){
+  struct faultstat *self, *all;
+
+  if(argptr(0, (void*)&self, sizeof(*self), 1) < 0 || argptr(1, (void*)&all, sizeof(*all), 1) < 0)
+    return -1;
+  getfaultstat(myproc(), self, all);
+  return 0;
+}
+
+//shmget함수의 구현부
+int
+sys_shmget(void){
+  int key, size, flag;
+
+  if(argint(0, &key) < 0 || argint(1, &size) < 0 || argint(2, &flag) < 0)
+    return -1;
+  return shmget(key, size, flag);
+}
+
+//shmat함수의 구현부
+//addr은 무시하고 커널이 빈 곳을 골라서 시작 주소를 반환한다. SHM_RDONLY만 지원한다.
+int
+sys_shmat(void){
+  int id, addr, flag;
+
+  if(argint(0, &id) < 0 || argint(1, &addr) < 0 || argint(2, &flag) < 0)
+    return -1;
+  if((flag & ~SHM_RDONLY) != 0)
+    return -1;
+  return shmat(id, flag);
+}
+
+//shmdt함수의 구현부
+int
+sys_shmdt(void){
+  int addr;
+
+  if(argint(0, &addr) < 0)
+    return -1;
+  return shmdt(addr);
+}
+
+//shmctl함수의 구현부
+int
+sys_shmctl(void){
+  int id, cmd;
+
+  if(argint(0, &id) < 0 || argint(1, &cmd) < 0)
+    return -1;
+  return shmctl(id, cmd);
+}
+
+//mmap함수의 구현부
+//addr은 무시하고 커널이 빈 곳을 골라서 시작 주소를 반환한다. MAP_PRIVATE만 지원한다.
+int
+sys_mmap(void){
+  int addr, len, prot, flags, fd, off;
+  struct file *f;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &prot) < 0 ||
+     argint(3, &flags) < 0 || argint(4, &fd) < 0 || argint(5, &off) < 0)
+    return -1;
+  if((flags & ~(MAP_PRIVATE|MAP_ANONYMOUS)) != 0)
+    return -1;
+  f = 0;
+  if(!(flags & MAP_ANONYMOUS)){
+    if(fd < 0 || fd >= NOFILE || (f = myproc()->ofile[fd]) == 0)
+      return -1;
+  }
+  return mmap(len, prot, f, off);
+}
+
+//munmap함수의 구현부
+int
+sys_munmap(void){
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  return munmap(addr, len);
+}
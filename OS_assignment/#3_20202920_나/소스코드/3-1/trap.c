@@ -9,12 +9,6 @@
 #include "spinlock.h"
 #include "date.h"
 
-//ptable 가져오기
-extern struct {
-    struct spinlock lock;
-    struct proc proc[NPROC];
-} ptable;
-
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
@@ -45,50 +39,40 @@ void
 trap(struct trapframe *tf)
 {
   if(tf->trapno == T_PGFLT){
-        uint va = rcr2(); // 잘못된 부분의 가상 주소를 가져옴
-        struct proc *curproc = myproc();
-
-        if(curproc == 0){
-            // 프로세스가 없는 경우에 대한 처리
-            panic("No process");
-        }
+    struct proc *curproc = myproc();
 
-        // 유효한 주소인지 확인
-        //현재 프로세스의 크기보다 큰 것은 아닌지 커널베이스를 넘어가는 것은 아닌지 확인
-        if(va >= curproc->sz || va >= KERNBASE){
-            cprintf("Memory is out of bound\n");
-            curproc->killed = 1;
-            return;
-        }
-        
-        // 물리 메모리 할당 및 매핑
-        char *phyMem = kalloc();
-        //물리 메모리가 부족하여 할당되지 않은 경우에 대한 예외처리
-        if(phyMem == 0){
-            cprintf("Out of physical memory.\n");
-            curproc->killed = 1;
-            return;
-        }
-        //물리메모리 영역을 0으로 초기화
-        memset(phyMem, 0, PGSIZE);
-        //주어진 가상 주소를 페이지 경계로 정렬
-        va = PGROUNDDOWN(va);
-        //가상주소와 새로운 물리주소를 매핑시켜줍니다.
-        if(mappages(curproc->pgdir, (char*)va, PGSIZE, V2P(phyMem), PTE_W|PTE_U|PTE_P) < 0){
-            kfree(phyMem);
-            cprintf("Mappages ERROR\n");
-            curproc->killed = 1;
-            return;
+    if(curproc == 0){
+      // 프로세스가 없는 경우에 대한 처리
+      panic("No process");
+    }
+    // 지연할당과 copy-on-write 페이지는 vm.c의 pgfault에서 처리한다.
+    if(pgfault(curproc, rcr2(), tf->err) < 0){
+      if((tf->cs&3) == 0){
+        // 시스템 콜에 넘긴 버퍼와 문자열은 argptr/argstr에서 미리 매핑하고 시스템 콜이 끝날 때까지 그대로 두므로
+        // 여기 오는 것은 exec가 argv 문자열을 새 주소 공간에 옮기다 메모리가 모자란 경우처럼 결과를 버릴 접근뿐이다.
+        // 프로세스만 죽인다. 그 주소에 버리는 페이지를 매핑해서 커널이 하던 일을 끝내게 하고,
+        // 사용자 모드로 돌아가기 전에 killed를 보고 exit한다.
+        if(killmap(curproc->pgdir, rcr2()) < 0){
+          cprintf("unexpected page fault from cpu %d eip %x (cr2=0x%x)\n",
+                  cpuid(), tf->eip, rcr2());
+          panic("trap");
         }
-        // 페이지 폴트 처리 완료
+        curproc->killed = 1;
         return;
+      }
+      curproc->killed = 1;
+      exit();
     }
+    // 페이지 폴트 처리 완료
+    return;
+  }
 
   if(tf->trapno == T_SYSCALL){
     if(myproc()->killed)
       exit();
     myproc()->tf = tf;
     syscall();
+    dfreecheck();
     if(myproc()->killed)
       exit();
     return;
@@ -101,49 +85,10 @@ trap(struct trapframe *tf)
       ticks++;
       wakeup(&ticks);
       release(&tickslock);
+      // 만료된 지연 해제 요청이 있으면 reclaim 스레드를 깨운다.
+      reclaimtick();
     }
     lapiceoi();
- // 지연 메모리 해제 처리 추가
-    struct proc *curproc = myproc();
-    if(curproc){
-        acquire(&ptable.lock);
-        if(curproc->pending_free_ticks > 0){
-            curproc->pending_free_ticks--;
-            if(curproc->pending_free_ticks == 0){
-                // 메모리 해제 수행
-                uint oldsz = curproc->sz;
-                uint newsz = curproc->pending_free_addr;
-
-                if(deallocuvm(curproc->pgdir, oldsz, newsz) == 0){
-                    cprintf("Memory Deallocation fault\n");
-                    curproc->killed = 1;
-                } else {
-                    curproc->sz = newsz;
-
-                    // 현재 시간 가져오기
-                    struct rtcdate curDateTime;
-                    cmostime(&curDateTime);
-                    //메모리 해제 시간에 대한 정보 출력
-                    cprintf("Memory deallocation execute: %d-%d-%d %d:%d:%d\n",
-                            curDateTime.year, curDateTime.month, curDateTime.day,
-                            curDateTime.hour, curDateTime.minute, curDateTime.second);
-
-                    // memstat() 호출
-                    procMemstat();
-
-                    // 메모리 해제 후 프로세스 종료
-                    curproc->killed = 1;
-                }
-
-                // 지연 해제 정보 초기화
-                curproc->pending_free_pages = 0;
-                curproc->pending_free_addr = 0;
-                curproc->allowDelayTicks = 0;       
-                memset(&curproc->ssusbrk_call_time, 0, sizeof(curproc->ssusbrk_call_time));
-            }
-        }
-        release(&ptable.lock);
-    }
     break;
   case T_IRQ0 + IRQ_IDE:
     ideintr();
@@ -183,6 +128,10 @@ trap(struct trapframe *tf)
     myproc()->killed = 1;
   }
 
+  // 실행 중이라 reclaim 스레드가 미뤄둔 지연 해제 요청을 처리한다.
+  if(myproc() && (tf->cs&3) == DPL_USER)
+    dfreecheck();
+
   // Force process exit if it has been killed and is in user space.
   // (If it is still executing in the kernel, let it keep running
   // until it gets to the regular system call return.)
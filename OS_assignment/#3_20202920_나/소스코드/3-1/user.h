@@ -1,5 +1,9 @@
 struct stat;
 struct rtcdate;
+struct memstat;
+struct swapstat;
+struct buddystat;
+struct faultstat;
 
 // system calls
 int fork(void);
@@ -25,6 +29,16 @@ int sleep(int);
 int uptime(void);
 int ssusbrk(int pageSize, int delayTicks);
 int memstat(void);
+int getmemstat(struct memstat*);
+int getswapstat(struct swapstat*);
+void* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int getbuddystat(struct buddystat*);
+int getfaultstat(struct faultstat*, struct faultstat*);
+int shmget(int, int, int);
+void* shmat(int, void*, int);
+int shmdt(void*);
+int shmctl(int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
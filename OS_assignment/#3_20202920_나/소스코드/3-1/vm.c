@@ -6,9 +6,55 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "spinlock.h"
+#include "mman.h"
+#include "slab.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
+char *zeropage; // 지연할당 페이지에서 읽기만 할 때 모든 프로세스가 읽기 전용으로 같이 쓰는 0으로 채운 페이지
+static char *trashpage; // 커널이 죽일 프로세스의 사용자 주소에 접근하다 폴트가 나면 대신 매핑해 두는 버리는 페이지
+
+// 주소 공간마다 물리 메모리가 매핑된 페이지 수, 공유 zero 페이지 수, 지연할당 페이지 수를
+// swap으로 내보낸 페이지 수를 매핑이 바뀔 때마다 바로 갱신해 두어서 memstat이 페이지 테이블을 훑지 않아도 되게 한다.
+// 값은 setupkvm이 페이지 디렉터리마다 slab에서 받아오는 struct vmspace에 두고,
+// 페이지 디렉터리의 물리 페이지 번호로 vmspaces[]에서 찾는다. 커널 페이지 테이블(kpgdir)에는 없다.
+#define VM_RSS   0
+#define VM_ZERO  1
+#define VM_LAZY  2
+#define VM_SWAP  3
+#define NVMSTAT  4
+
+struct vmspace {
+  uint stat[NVMSTAT];
+  int ncpu;                   // 이 페이지 테이블을 cr3에 올려두고 있는 cpu 수, tlblock으로 보호한다.
+  int dead;                   // freevm이 불렸지만 올려둔 cpu가 있어서 해제를 미뤄뒀으면 1, tlblock으로 보호한다.
+  uint tlbgen;                // PTE를 지우거나 권한을 줄일 때마다 1씩 늘어나는 번호
+};
+
+static struct slabcache vmspacecache;
+static struct vmspace *vmspaces[PHYSTOP >> PTXSHIFT];
+
+// deallocuvm에서 이 페이지 수까지는 invlpg로 한 페이지씩 비우고, 더 많으면 cr3를 다시 올린다.
+#define INVLPG_MAX 32
+
+static inline struct vmspace*
+vmspace(pde_t *pgdir)
+{
+  return vmspaces[V2P(pgdir) >> PTXSHIFT];
+}
+
+static void
+vmstat_add(pde_t *pgdir, int which, int n)
+{
+  vmspace(pgdir)->stat[which] += n;
+}
+
+static uint
+vmstat_get(pde_t *pgdir, int which)
+{
+  return vmspace(pgdir)->stat[which];
+}
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
@@ -32,6 +78,8 @@ seginit(void)
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
+// va가 4MB 페이지 안에 있으면 페이지 테이블이 없으므로 PDE 자체를 돌려준다.
+// 호출한 쪽은 PTE_PS로 구분하고, 물리 주소는 pteaddr로 구한다.
 pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
@@ -40,12 +88,13 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 
   pde = &pgdir[PDX(va)];
   if(*pde & PTE_P){
+    if(*pde & PTE_PS)
+      return (pte_t*)pde;
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
-    if(!alloc || (pgtab = (pte_t*)kalloc()) == 0)
-      return 0;
     // Make sure all those PTE_P bits are zero.
-    memset(pgtab, 0, PGSIZE);
+    if(!alloc || (pgtab = (pte_t*)kzalloc()) == 0)
+      return 0;
     // The permissions here are overly generous, but they can
     // be further restricted by the permissions in the page table
     // entries, if necessary.
@@ -54,6 +103,223 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   return &pgtab[PTX(va)];
 }
 
+// PTE(또는 4MB 페이지의 PDE)가 가리키는 va의 4KB 페이지 물리 주소를 구한다.
+static uint
+pteaddr(pte_t pte, uint va)
+{
+  if(pte & PTE_PS)
+    return LPTE_ADDR(pte) + (PGROUNDDOWN(va) & (LPGSIZE-1));
+  return PTE_ADDR(pte);
+}
+
+// 지연 TLB 전환
+// 스케줄러는 프로세스에서 돌아온 뒤 커널 페이지 테이블로 바꾸지 않고 마지막 사용자 페이지 테이블을 그대로 둔다.
+// 다음에 같은 페이지 테이블을 가진 프로세스를 실행하면 cr3를 다시 올리지 않으므로 TLB가 그대로 남는다.
+// 그 사이에 다른 cpu에서 PTE를 지우거나 권한을 줄였으면 vmspace의 tlbgen이 달라져 있으므로 그때만 다시 올린다.
+// cpu가 올려두고 있는 페이지 테이블은 커널 매핑이 사라지면 안 되므로 freevm이 바로 해제하지 않고
+// 마지막으로 올려둔 cpu가 다른 페이지 테이블로 바꿀 때 해제한다.
+static struct spinlock tlblock;
+
+static inline void
+invlpg(void *addr)
+{
+  asm volatile("invlpg (%0)" : : "r" (addr) : "memory");
+}
+
+// 페이지 테이블 페이지들과 페이지 디렉터리, vmspace를 해제한다. 사용자 메모리는 이미 deallocuvm으로 해제되어 있어야 한다.
+static void
+freept(pde_t *pgdir)
+{
+  struct vmspace *vs;
+  uint i;
+
+  for(i = 0; i < NPDENTRIES; i++){
+    if(pgdir[i] & PTE_P){
+      char * v = P2V(PTE_ADDR(pgdir[i]));
+      kfree(v);
+    }
+  }
+  if((vs = vmspace(pgdir)) != 0){
+    vmspaces[V2P(pgdir) >> PTXSHIFT] = 0;
+    slabfree(&vmspacecache, vs);
+  }
+  kfree((char*)pgdir);
+}
+
+// cpu c의 cr3를 pgdir로 바꾼다. pgdir이 0이면 커널 페이지 테이블로 바꾼다. pushcli한 상태에서 호출해야 한다.
+// 놓은 페이지 테이블이 해제를 기다리고 있었고 더 이상 올려둔 cpu가 없으면 여기서 해제한다.
+static void
+loadpgdir(struct cpu *c, pde_t *pgdir)
+{
+  pde_t *old, *dead;
+
+  dead = 0;
+  acquire(&tlblock);
+  old = c->pgdir;
+  if(old != pgdir){
+    if(old && --vmspace(old)->ncpu == 0 && vmspace(old)->dead)
+      dead = old;
+    if(pgdir)
+      vmspace(pgdir)->ncpu++;
+    c->pgdir = pgdir;
+  }
+  if(pgdir){
+    c->tlbgen = vmspace(pgdir)->tlbgen;
+    lcr3(V2P(pgdir));
+  } else
+    lcr3(V2P(kpgdir));
+  release(&tlblock);
+  if(dead)
+    freept(dead);
+}
+
+// pgdir의 PTE를 여러 개 지우거나 권한을 줄인 뒤에 부른다.
+// 이 cpu가 pgdir을 올려두고 있으면 cr3를 다시 올리고, 다른 cpu는 이 페이지 테이블로 바꿀 때 다시 올린다.
+void
+tlbflush(pde_t *pgdir)
+{
+  struct cpu *c;
+
+  pushcli();
+  c = mycpu();
+  vmspace(pgdir)->tlbgen++;
+  if(c->pgdir == pgdir){
+    c->tlbgen = vmspace(pgdir)->tlbgen;
+    lcr3(V2P(pgdir));
+  }
+  popcli();
+}
+
+// pgdir에서 va 한 페이지의 PTE를 지우거나 권한을 줄인 뒤에 부른다. 이 cpu에서는 invlpg로 그 페이지만 비운다.
+void
+tlbinval(pde_t *pgdir, uint va)
+{
+  struct cpu *c;
+
+  pushcli();
+  c = mycpu();
+  if(c->pgdir != pgdir || c->tlbgen != vmspace(pgdir)->tlbgen){
+    //이 cpu에 올라가 있지 않거나 다른 곳에서 바뀐 PTE가 이미 남아있으면 번호만 올리거나 전부 비운다.
+    popcli();
+    tlbflush(pgdir);
+    return;
+  }
+  c->tlbgen = ++vmspace(pgdir)->tlbgen;
+  invlpg((void*)va);
+  popcli();
+}
+
+// 실행할 프로세스가 없을 때 스케줄러가 부른다.
+// 올려두고 있던 페이지 테이블이 해제를 기다리고 있으면 커널 페이지 테이블로 바꿔서 놓아준다.
+void
+tlbidle(void)
+{
+  struct cpu *c;
+
+  pushcli();
+  c = mycpu();
+  if(c->pgdir && vmspace(c->pgdir)->dead)
+    loadpgdir(c, 0);
+  popcli();
+}
+
+// va가 속한 4MB 구간을 4MB 페이지 하나로 0으로 채워서 매핑한다.
+// 이미 페이지 테이블이 있거나 남은 4MB 페이지가 없으면 -1을 반환하고, 호출한 쪽은 4KB 페이지로 처리한다.
+static int
+maplarge(pde_t *pgdir, uint va)
+{
+  pde_t *pde = &pgdir[PDX(va)];
+  char *mem;
+
+  if(*pde & PTE_P)
+    return -1;
+  if((mem = kalloc4m()) == 0)
+    return -1;
+  memset(mem, 0, LPGSIZE);
+  *pde = V2P(mem) | PTE_PS | PTE_W | PTE_U | PTE_P;
+  vmstat_add(pgdir, VM_RSS, NPTENTRIES);
+  return 0;
+}
+
+// 4MB 페이지를 같은 내용의 4KB 페이지들로 쪼갠다. 새 페이지들은 이 프로세스만 쓰므로 copy-on-write가 풀린다.
+// 메모리가 부족하면 아무것도 바꾸지 않고 -1을 반환한다.
+static int
+splitlarge(pde_t *pgdir, uint va)
+{
+  pde_t *pde = &pgdir[PDX(va)];
+  pte_t *pgtab;
+  char *large, *mem;
+  uint flags;
+  int i;
+
+  large = P2V(LPTE_ADDR(*pde));
+  flags = PTE_FLAGS(*pde) & ~PTE_PS;
+  if(flags & PTE_COW)
+    flags = (flags | PTE_W) & ~PTE_COW;
+  if((pgtab = (pte_t*)kzalloc()) == 0)
+    return -1;
+  for(i = 0; i < NPTENTRIES; i++){
+    if((mem = kalloc()) == 0){
+      while(--i >= 0)
+        kfree(P2V(PTE_ADDR(pgtab[i])));
+      kfree((char*)pgtab);
+      return -1;
+    }
+    memmove(mem, large + i*PGSIZE, PGSIZE);
+    pgtab[i] = V2P(mem) | flags;
+  }
+  *pde = V2P(pgtab) | PTE_P | PTE_W | PTE_U;
+  kfree4m(large);
+  tlbflush(pgdir);
+  return 0;
+}
+
+// 4MB로 지연할당해 둔 구간을 4KB 지연할당 PTE들로 바꾼다. 페이지 테이블을 받을 메모리가 없으면 -1을 반환한다.
+static int
+splitlazy(pde_t *pgdir, uint va)
+{
+  pte_t *pgtab;
+  int i;
+
+  if((pgtab = (pte_t*)kzalloc()) == 0)
+    return -1;
+  for(i = 0; i < NPTENTRIES; i++)
+    pgtab[i] = PTE_W | PTE_U;
+  pgdir[PDX(va)] = V2P(pgtab) | PTE_P | PTE_W | PTE_U;
+  return 0;
+}
+
+//va를 덮는 4MB 페이지(지연할당 구간 포함)가 [lo, hi)에 다 들어가지 않으면 4KB 페이지로 쪼갠다.
+static int
+splitedge(pde_t *pgdir, uint va, uint lo, uint hi)
+{
+  uint start = LPGROUNDDOWN(va);
+  pde_t pde = pgdir[PDX(va)];
+
+  if(!(pde & PTE_PS))
+    return 0;
+  if(start >= lo && start + LPGSIZE <= hi)
+    return 0;
+  if(!(pde & PTE_P))
+    return splitlazy(pgdir, va);
+  return splitlarge(pgdir, va);
+}
+
+//사용자 페이지로 쓸 물리 메모리를 할당한다. 남은 메모리가 없으면 다른 페이지를 swap으로 내보내고 다시 시도한다.
+//swap도 가득 찼거나 내보낼 페이지가 없으면 0을 반환한다.
+char*
+uvmkalloc(int zero)
+{
+  char *mem;
+
+  for(;;){
+    if((mem = zero ? kzalloc() : kalloc()) != 0)
+      return mem;
+    if(swapout() < 0)
+      return 0;
+  }
+}
+
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
@@ -70,6 +336,11 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
       return -1;
     if(*pte & PTE_P)
       panic("remap");
+    if(perm & PTE_U){
+      if(*pte)
+        vmstat_add(pgdir, VM_LAZY, -1); //지연할당 PTE에 물리 메모리가 매핑된다.
+      vmstat_add(pgdir, pa == V2P(zeropage) ? VM_ZERO : VM_RSS, 1);
+    }
     *pte = pa | perm | PTE_P;
     if(a == last)
       break;
@@ -115,37 +386,64 @@ static struct kmap {
 };
 
 // Set up kernel part of a page table.
-pde_t*
-setupkvm(void)
+static pde_t*
+kvmcreate(void)
 {
   pde_t *pgdir;
   struct kmap *k;
 
-  if((pgdir = (pde_t*)kalloc()) == 0)
+  if((pgdir = (pde_t*)kzalloc()) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
   if (P2V(PHYSTOP) > (void*)DEVSPACE)
     panic("PHYSTOP too high");
   for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
     if(mappages(pgdir, k->virt, k->phys_end - k->phys_start,
                 (uint)k->phys_start, k->perm) < 0) {
-      freevm(pgdir);
+      //사용자 매핑이 없으므로 페이지 테이블만 해제하면 된다.
+      freept(pgdir);
       return 0;
     }
   return pgdir;
 }
 
+// 사용자 프로세스용 페이지 테이블을 만든다. 커널 부분은 kvmcreate와 같고, 페이지 수를 셀 vmspace를 붙인다.
+pde_t*
+setupkvm(void)
+{
+  pde_t *pgdir;
+  struct vmspace *vs;
+
+  if((vs = slaballoc(&vmspacecache)) == 0)
+    return 0;
+  if((pgdir = kvmcreate()) == 0){
+    slabfree(&vmspacecache, vs);
+    return 0;
+  }
+  memset(vs, 0, sizeof(*vs));
+  vmspaces[V2P(pgdir) >> PTXSHIFT] = vs;
+  return pgdir;
+}
+
 // Allocate one page table for the machine for the kernel address
 // space for scheduler processes.
 void
 kvmalloc(void)
 {
-  kpgdir = setupkvm();
+  initlock(&tlblock, "tlb");
+  slabinit(&vmspacecache, "vmspace", sizeof(struct vmspace), 0);
+  //아직 cpu를 찾을 수 없어서 slab을 쓸 수 없으므로 커널 페이지 테이블은 vmspace 없이 만든다.
+  kpgdir = kvmcreate();
   switchkvm();
+  if((zeropage = kalloc()) == 0)
+    panic("kvmalloc: zeropage");
+  memset(zeropage, 0, PGSIZE);
+  if((trashpage = kalloc()) == 0)
+    panic("kvmalloc: trashpage");
 }
 
 // Switch h/w page table register to the kernel-only page table,
 // for when no process is running.
+// 부팅할 때만 쓰인다. 스케줄러는 프로세스에서 돌아와도 커널 페이지 테이블로 바꾸지 않는다.
 void
 switchkvm(void)
 {
@@ -156,6 +454,8 @@ switchkvm(void)
 void
 switchuvm(struct proc *p)
 {
+  struct cpu *c;
+
   if(p == 0)
     panic("switchuvm: no process");
   if(p->kstack == 0)
@@ -173,7 +473,10 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
-  lcr3(V2P(p->pgdir));  // switch to process's address space
+  //같은 페이지 테이블이 이미 올라가 있고 그 뒤로 바뀐 PTE가 없으면 cr3를 다시 올리지 않는다.
+  c = mycpu();
+  if(c->pgdir != p->pgdir || c->tlbgen != vmspace(p->pgdir)->tlbgen)
+    loadpgdir(c, p->pgdir);  // switch to process's address space
   popcli();
 }
 
@@ -194,6 +497,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
 
 // Load a program segment into pgdir.  addr must be page-aligned
 // and the pages from addr to addr+sz must already be mapped.
+// 물리 메모리가 없는(PTE_P가 꺼진) 페이지를 만나면 -1을 반환한다.
 int
 loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 {
@@ -205,7 +509,9 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
   for(i = 0; i < sz; i += PGSIZE){
     if((pte = walkpgdir(pgdir, addr+i, 0)) == 0)
       panic("loaduvm: address should exist");
-    pa = PTE_ADDR(*pte);
+    if(!(*pte & PTE_P))
+      return -1;
+    pa = pteaddr(*pte, (uint)addr+i);
     if(sz - i < PGSIZE)
       n = sz - i;
     else
@@ -231,13 +537,18 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    //4MB로 정렬된 구간 전체가 새로 할당되면 4MB 페이지 하나로 채워서 페이지 테이블과 TLB 항목을 아낀다.
+    if(a % LPGSIZE == 0 && newsz - a >= LPGSIZE && maplarge(pgdir, a) == 0){
+      a += LPGSIZE - PGSIZE;
+      continue;
+    }
+    //미리 0으로 채워둔 페이지를 받아서 여기서 memset하지 않는다.
+    mem = kzalloc();
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
       cprintf("allocuvm out of memory (2)\n");
       deallocuvm(pgdir, newsz, oldsz);
@@ -252,17 +563,48 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
 // process size.  Returns the new process size.
+// 4MB 페이지는 구간 전체가 해제될 때 통째로 돌려주고, 일부만 해제되면
+// 먼저 4KB 페이지로 쪼갠 뒤 해제되는 부분만 돌려준다.
+// 쪼갤 메모리가 없으면 아무것도 해제하지 않고 0을 반환한다.
 int
 deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
+  pde_t *pde;
   pte_t *pte;
-  uint a, pa;
+  uint a, pa, end;
+  int few, changed;
 
   if(newsz >= oldsz)
     return oldsz;
 
   a = PGROUNDUP(newsz);
+  //양 끝이 4MB 페이지의 중간에 걸리면 해제를 시작하기 전에 쪼개서, 실패해도 주소 공간이 그대로 남게 한다.
+  if(a < oldsz && (splitedge(pgdir, a, a, oldsz) < 0 || splitedge(pgdir, oldsz - 1, a, oldsz) < 0)){
+    cprintf("Out of physical memory.\n");
+    return 0;
+  }
+  //몇 페이지만 줄어들면 invlpg로 그 페이지들만 비우고, 많이 줄어들면 끝에서 한 번에 비운다.
+  few = a >= oldsz || oldsz - a <= INVLPG_MAX*PGSIZE;
+  changed = 0;
   for(; a  < oldsz; a += PGSIZE){
+    pde = &pgdir[PDX(a)];
+    if((*pde & (PTE_P|PTE_PS)) == (PTE_P|PTE_PS)){
+      //걸쳐 있던 4MB 페이지는 위에서 쪼갰으므로 여기 오는 것은 통째로 해제되는 페이지뿐이다.
+      end = LPGROUNDDOWN(a) + LPGSIZE;
+      kfree4m(P2V(LPTE_ADDR(*pde)));
+      *pde = 0;
+      vmstat_add(pgdir, VM_RSS, -NPTENTRIES);
+      changed = 1;
+      a = end - PGSIZE;
+      continue;
+    } else if((*pde & (PTE_P|PTE_PS)) == PTE_PS){
+      //4MB 지연할당 구간도 걸쳐 있던 것은 위에서 4KB 지연할당 PTE로 바꿨으므로 PDE만 지운다.
+      end = LPGROUNDDOWN(a) + LPGSIZE;
+      *pde = 0;
+      vmstat_add(pgdir, VM_LAZY, -NPTENTRIES);
+      a = end - PGSIZE;
+      continue;
+    }
     pte = walkpgdir(pgdir, (char*)a, 0);
     if(!pte)
       a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
@@ -271,10 +613,27 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       if(pa == 0)
         panic("kfree");
       char *v = P2V(pa);
-      kfree(v);
+      if(v != zeropage && v != trashpage) //공유 zero 페이지와 trashpage는 해제하지 않는다.
+        kfree(v);
+      if(*pte & PTE_U)
+        vmstat_add(pgdir, v == zeropage ? VM_ZERO : VM_RSS, -1);
+      *pte = 0;
+      if(few)
+        tlbinval(pgdir, a);
+      else
+        changed = 1;
+    } else if(*pte & PTE_SWAP){
+      swapfree(PTE_ADDR(*pte) >> PTXSHIFT);
+      vmstat_add(pgdir, VM_SWAP, -1);
+      *pte = 0;
+    } else if(*pte != 0){
+      //아직 물리 메모리가 없는 지연할당 PTE도 지워야 해제된 구간에서 다시 폴트로 살아나지 않는다.
+      vmstat_add(pgdir, VM_LAZY, -1);
       *pte = 0;
     }
   }
+  if(changed)
+    tlbflush(pgdir);
   return newsz;
 }
 
@@ -283,18 +642,18 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 void
 freevm(pde_t *pgdir)
 {
-  uint i;
-
   if(pgdir == 0)
     panic("freevm: no pgdir");
   deallocuvm(pgdir, KERNBASE, 0);
-  for(i = 0; i < NPDENTRIES; i++){
-    if(pgdir[i] & PTE_P){
-      char * v = P2V(PTE_ADDR(pgdir[i]));
-      kfree(v);
-    }
+  //다른 cpu가 아직 cr3에 올려두고 있으면 그 cpu가 놓을 때 loadpgdir에서 해제한다.
+  acquire(&tlblock);
+  if(vmspace(pgdir)->ncpu > 0){
+    vmspace(pgdir)->dead = 1;
+    release(&tlblock);
+    return;
   }
-  kfree((char*)pgdir);
+  release(&tlblock);
+  freept(pgdir);
 }
 
 // Clear PTE_U on a page. Used to create an inaccessible
@@ -305,43 +664,93 @@ clearpteu(pde_t *pgdir, char *uva)
   pte_t *pte;
 
   pte = walkpgdir(pgdir, uva, 0);
-  if(pte == 0)
+  if(pte == 0 || (*pte & PTE_PS))
     panic("clearpteu");
+  if(*pte & PTE_U)
+    vmstat_add(pgdir, VM_RSS, -1); //사용자가 접근할 수 없는 페이지는 세지 않는다.
   *pte &= ~PTE_U;
 }
 
 // Given a parent process's page table, create a copy
 // of it for a child.
+// 물리 페이지는 복사하지 않고 부모와 자식이 읽기 전용으로 공유한다(copy-on-write).
+// 쓰기 가능하던 페이지는 양쪽 모두 PTE_W를 빼고 PTE_COW를 붙여서, 처음 쓰기가 일어날 때 pgfault에서 복사한다.
+// 아직 물리 메모리가 없는 지연할당 페이지는 PTE만 그대로 복사한다.
+// 4MB 페이지는 PDE 하나를 같은 방식으로 통째로 공유한다.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
-  pte_t *pte;
-  uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
+  if(copyvma(pgdir, d, 0, sz) < 0){
+    freevm(d);
+    return 0;
+  }
+  return d;
+}
+
+// pgdir의 [start, end) 구간을 d로 copy-on-write 복사한다. copyuvm과 mmap 영역의 fork에서 쓴다.
+int
+copyvma(pde_t *pgdir, pde_t *d, uint start, uint end)
+{
+  pde_t *pde;
+  pte_t *pte, *dpte;
+  uint pa, i, flags;
+
+  for(i = start; i < end; i += PGSIZE){
+    pde = &pgdir[PDX(i)];
+    if(*pde & PTE_PS){
+      if((*pde & PTE_P) && (*pde & PTE_W))
+        *pde = (*pde & ~PTE_W) | PTE_COW;
+      d[PDX(i)] = *pde;
+      if(*pde & PTE_P){
+        kincref(P2V(LPTE_ADDR(*pde)));
+        vmstat_add(d, VM_RSS, NPTENTRIES);
+      } else
+        vmstat_add(d, VM_LAZY, NPTENTRIES);
+      i = LPGROUNDDOWN(i) + LPGSIZE - PGSIZE;
+      continue;
+    }
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      //mmap 영역은 아직 한 번도 접근하지 않았으면 페이지 테이블이 없다.
+      if(start != 0){
+        i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+        continue;
+      }
       panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+    }
+    if(!(*pte & PTE_P)){
+      if(*pte == 0)
+        continue;
+      if((dpte = walkpgdir(d, (void *) i, 1)) == 0)
+        goto bad;
+      *dpte = *pte;
+      if(*pte & PTE_SWAP){
+        //swap으로 내보낸 페이지는 slot을 같이 가리킨다.
+        swapdup(PTE_ADDR(*pte) >> PTXSHIFT);
+        vmstat_add(d, VM_SWAP, 1);
+      } else
+        vmstat_add(d, VM_LAZY, 1);
+      continue;
+    }
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
       goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
-      goto bad;
-    }
+    if(P2V(pa) != zeropage)
+      kincref(P2V(pa));
   }
-  return d;
+  // 부모의 PTE에서 PTE_W를 뺐으므로 TLB에 남아있는 쓰기 권한을 비운다.
+  tlbflush(pgdir);
+  return 0;
 
 bad:
-  freevm(d);
-  return 0;
+  tlbflush(pgdir);
+  return -1;
 }
 
 //PAGEBREAK!
@@ -356,7 +765,7 @@ uva2ka(pde_t *pgdir, char *uva)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
-  return (char*)P2V(PTE_ADDR(*pte));
+  return (char*)P2V(pteaddr(*pte, (uint)uva));
 }
 
 // Copy len bytes from p to user address va in page table pgdir.
@@ -385,6 +794,401 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
   return 0;
 }
 
+//ssusbrk에서 SSUSBRK_LARGE로 요청한 구간 중 4MB로 정렬되어 통째로 들어가는 부분을
+//4MB 지연할당 PDE(PTE_PS만 있고 PTE_P는 없는 PDE)로 바꾼다. 처음 접근할 때 pgfault에서 4MB 페이지를 할당한다.
+//allocuvm_without_alloc으로 4KB 지연할당 PTE를 만든 뒤에 호출하며, 이미 매핑된 페이지가 있는 구간은 그대로 둔다.
+void
+lazylargeuvm(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  pde_t *pde;
+  pte_t *pgtab;
+  uint a;
+  int i;
+
+  for(a = LPGROUNDUP(oldsz); a < newsz && newsz - a >= LPGSIZE; a += LPGSIZE){
+    pde = &pgdir[PDX(a)];
+    if((*pde & (PTE_P|PTE_PS)) != PTE_P)
+      continue;
+    pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
+    for(i = 0; i < NPTENTRIES; i++)
+      if(pgtab[i] & PTE_P)
+        break;
+    if(i < NPTENTRIES)
+      continue;
+    for(i = 0; i < NPTENTRIES; i++)
+      if(pgtab[i])
+        vmstat_add(pgdir, VM_LAZY, -1);
+    kfree((char*)pgtab);
+    *pde = PTE_PS | PTE_W | PTE_U;
+    vmstat_add(pgdir, VM_LAZY, NPTENTRIES);
+  }
+}
+
+//지연할당된 페이지 하나에 0으로 채운 물리 메모리를 할당해서 매핑한다.
+//읽기 폴트(write == 0)면 물리 메모리를 쓰지 않고 공유 zero 페이지를 읽기 전용으로 매핑한다.
+int
+lazymap(pde_t *pgdir, uint va, int write)
+{
+  pte_t *pte;
+  pte_t old;
+  char *mem;
+
+  if(!write)
+    return mappages(pgdir, (char*)va, PGSIZE, V2P(zeropage), PTE_U);
+
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  old = pte ? *pte : 0;
+  // 물리 메모리 할당 및 매핑
+  //idle cpu가 미리 0으로 채워둔 페이지를 받아온다. 없으면 kzalloc 안에서 0으로 채운다.
+  mem = uvmkalloc(1);
+  //물리 메모리가 부족하여 할당되지 않은 경우에 대한 예외처리
+  if(mem == 0){
+    cprintf("Out of physical memory.\n");
+    return -1;
+  }
+  //swap으로 내보내면서 잠든 사이 지연 해제 등으로 PTE가 바뀌었으면 매핑하지 않는다.
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  if((pte ? *pte : 0) != old){
+    kfree(mem);
+    return 0;
+  }
+  //가상주소와 새로운 물리주소를 매핑시켜줍니다.
+  if(mappages(pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    cprintf("Mappages ERROR\n");
+    return -1;
+  }
+  return 0;
+}
+
+//순차적으로 폴트가 나고 있으면 va 다음의 지연할당 페이지들을 미리 매핑해서 트랩 횟수를 줄인다.
+//바로 앞의 폴트에서 매핑한 구간의 끝에서 다시 폴트가 나면 순차 접근으로 보고,
+//FAULTAROUND_START번 이어진 뒤부터 2, 4, 8, ... 페이지씩 FAULTAROUND_MAX까지 늘려간다.
+//띄엄띄엄 접근하면 한 페이지씩만 매핑하므로 지연할당의 이점은 그대로 유지된다.
+//추측으로 매핑하는 것이므로 남은 메모리가 없으면 swap을 일으키지 않고 멈춘다.
+static void
+faultaround(struct proc *p, uint va, int write)
+{
+  pte_t *pte;
+  char *mem;
+  uint a;
+  int window, n;
+
+  if(va == p->fault_next){
+    if(p->fault_seq < FAULTAROUND_START + 16)
+      p->fault_seq++;
+  } else {
+    p->fault_seq = 0;
+  }
+
+  window = 1;
+  if(p->fault_seq >= FAULTAROUND_START){
+    window = 2 << (p->fault_seq - FAULTAROUND_START);
+    if(window > FAULTAROUND_MAX)
+      window = FAULTAROUND_MAX;
+  }
+
+  //아직 물리 메모리가 없는 지연할당 PTE만 미리 매핑하고, 이미 매핑된 페이지를 만나면 멈춘다.
+  for(a = va + PGSIZE, n = 1; n < window && a < p->sz && a < KERNBASE; a += PGSIZE, n++){
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if(pte == 0 || (*pte & (PTE_P|PTE_FILE|PTE_SWAP)) || !(*pte & PTE_U))
+      break;
+    if(!write){
+      if(lazymap(p->pgdir, a, 0) < 0)
+        break;
+      continue;
+    }
+    if((mem = kzalloc()) == 0)
+      break;
+    //아직 접근하지 않은 페이지라 PTE_A가 꺼져 있으면 clock 바늘이 가장 먼저 내보내므로 켜서 매핑한다.
+    if(mappages(p->pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U|PTE_A) < 0){
+      kfree(mem);
+      break;
+    }
+  }
+  p->fault_next = a;
+}
+
+//exec가 PTE_FILE로 표시해 둔 페이지를 실행 파일에서 읽어서 매핑한다.
+//파일 내용이 페이지 중간에서 끝나면 나머지는 0으로 남는다.
+static int
+filemap(struct proc *p, uint va)
+{
+  struct fmap *m;
+  pte_t *pte;
+  char *mem;
+  uint n;
+
+  for(m = p->fmap; m < &p->fmap[NFMAP]; m++)
+    if(m->ip && va >= m->va && va < m->va + m->filesz)
+      break;
+  if(m == &p->fmap[NFMAP]){
+    cprintf("No file mapping\n");
+    return -1;
+  }
+  if((mem = uvmkalloc(1)) == 0){
+    cprintf("Out of physical memory.\n");
+    return -1;
+  }
+  n = m->va + m->filesz - va;
+  if(n > PGSIZE)
+    n = PGSIZE;
+  ilock(m->ip);
+  if(readi(m->ip, mem, m->off + (va - m->va), n) != n){
+    iunlock(m->ip);
+    kfree(mem);
+    cprintf("Read ERROR\n");
+    return -1;
+  }
+  iunlock(m->ip);
+  //디스크를 기다리는 동안 지연 해제로 PTE가 지워졌으면 매핑하지 않는다.
+  pte = walkpgdir(p->pgdir, (char*)va, 0);
+  if(pte == 0 || (*pte & (PTE_P|PTE_FILE)) != PTE_FILE){
+    kfree(mem);
+    return 0;
+  }
+  if(mappages(p->pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    cprintf("Mappages ERROR\n");
+    return -1;
+  }
+  return 0;
+}
+
+//swap으로 내보냈던 페이지를 읽어와서 다시 매핑한다.
+//copy-on-write 표시가 남아있던 페이지도 새로 읽어온 페이지는 이 프로세스만 쓰므로 쓰기를 허용한다.
+static int
+swapmap(struct proc *p, uint va, pte_t old)
+{
+  uint slot = PTE_ADDR(old) >> PTXSHIFT;
+  uint flags = PTE_FLAGS(old) & (PTE_W|PTE_U|PTE_COW);
+  pte_t *pte;
+  char *mem;
+
+  if((mem = uvmkalloc(0)) == 0){
+    cprintf("Out of physical memory.\n");
+    return -1;
+  }
+  swapin(slot, mem);
+  //디스크를 기다리는 동안 지연 해제로 PTE가 바뀌었으면 읽어온 내용을 버린다.
+  pte = walkpgdir(p->pgdir, (char*)va, 0);
+  if(pte == 0 || *pte != old){
+    kfree(mem);
+    return 0;
+  }
+  *pte = 0;
+  vmstat_add(p->pgdir, VM_SWAP, -1);
+  swapfree(slot);
+  if(flags & PTE_COW)
+    flags = (flags | PTE_W) & ~PTE_COW;
+  if(mappages(p->pgdir, (char*)va, PGSIZE, V2P(mem), flags) < 0){
+    kfree(mem);
+    cprintf("Mappages ERROR\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int faultin(struct proc *p, uint va, uint err, int *type);
+
+//cpu별로 모으는 시스템 전체의 페이지 폴트 통계, getfaultstat에서 더해서 돌려준다.
+static struct faultstat cpufst[NCPU];
+
+static inline unsigned long long
+rdtsc(void)
+{
+  unsigned long long t;
+
+  asm volatile("rdtsc" : "=A" (t));
+  return t;
+}
+
+//폴트 하나의 종류와 처리 시간을 st에 더한다.
+static void
+faultacct(struct faultstat *st, int type, unsigned long long dt)
+{
+  int b;
+
+  for(b = 0; b < NFLTBUCKET-1 && (dt >> (10 + b)) != 0; b++)
+    ;
+  st->count[type]++;
+  st->kcycles[type] += (uint)(dt >> 10);
+  st->hist[type][b]++;
+}
+
+//p의 폴트 통계와 모든 cpu의 통계를 더한 시스템 전체 통계를 채운다.
+void
+getfaultstat(struct proc *p, struct faultstat *self, struct faultstat *all)
+{
+  uint *d, *s;
+  int c, i;
+
+  *self = p->fst;
+  memset(all, 0, sizeof(*all));
+  //다른 cpu의 통계는 락 없이 읽으므로 그 순간의 대략적인 값이다.
+  for(c = 0; c < NCPU; c++){
+    d = (uint*)all;
+    s = (uint*)&cpufst[c];
+    for(i = 0; i < sizeof(*all)/sizeof(uint); i++)
+      d[i] += s[i];
+  }
+}
+
+//사용자 주소 va에서 난 페이지 폴트를 처리한다. err는 하드웨어가 넘겨준 에러 코드다.
+//지연할당된 페이지면 물리 메모리를 할당해서 매핑하고(읽기만 했으면 공유 zero 페이지를 매핑하고),
+//copy-on-write 페이지나 공유 zero 페이지에 쓰기를 했으면 새 페이지를 만들어서 쓰기 가능하게 바꾼다.
+//처리할 수 없는 폴트면 -1을 반환하고, 호출한 쪽에서 프로세스를 종료시킨다.
+//처리 시간은 rdtsc로 재서 폴트 종류별로 프로세스와 cpu의 통계에 더한다.
+int
+pgfault(struct proc *p, uint va, uint err)
+{
+  unsigned long long t0, dt;
+  int r, type;
+
+  t0 = rdtsc();
+  r = faultin(p, va, err, &type);
+  dt = rdtsc() - t0;
+  if(r < 0)
+    type = FLT_KILL;
+  faultacct(&p->fst, type, dt);
+  pushcli();
+  faultacct(&cpufst[cpuid()], type, dt);
+  popcli();
+  return r;
+}
+
+//pgfault의 본체. 처리한 폴트의 종류를 *type에 넣는다.
+static int
+faultin(struct proc *p, uint va, uint err, int *type)
+{
+  pde_t *pde;
+  pte_t *pte, old;
+  uint pa, flags, end;
+  char *mem;
+  struct vma *v;
+
+  // 유효한 주소인지 확인
+  //현재 프로세스의 크기보다 큰 것은 아닌지 커널베이스를 넘어가는 것은 아닌지 확인
+  //힙 밖이면 mmap으로 만든 영역 안인지 확인한다.
+  v = 0;
+  if(va >= KERNBASE || (va >= p->sz && (v = findvma(p, va)) == 0)){
+    cprintf("Memory is out of bound\n");
+    return -1;
+  }
+  if(v && (err & FEC_WR) && !(v->prot & PROT_WRITE)){
+    cprintf("Protection fault\n");
+    return -1;
+  }
+  //주어진 가상 주소를 페이지 경계로 정렬
+  va = PGROUNDDOWN(va);
+  pde = &p->pgdir[PDX(va)];
+
+  if((*pde & (PTE_P|PTE_PS)) == PTE_PS){
+    //4MB 페이지로 지연할당해 둔 구간이면 처음 접근할 때 4MB 페이지 하나를 할당한다.
+    //남은 4MB 페이지가 없으면 4KB 지연할당 페이지들로 바꿔서 아래에서 처리한다.
+    *pde = 0;
+    vmstat_add(p->pgdir, VM_LAZY, -NPTENTRIES);
+    *type = FLT_LAZY;
+    if(maplarge(p->pgdir, va) == 0)
+      return 0;
+    end = LPGROUNDDOWN(va) + LPGSIZE;
+    if(end > p->sz)
+      end = p->sz;
+    if(allocuvm_without_alloc(p->pgdir, LPGROUNDDOWN(va), end) == 0)
+      return -1;
+  } else if((*pde & (PTE_P|PTE_PS)) == (PTE_P|PTE_PS)){
+    //4MB 페이지에서는 copy-on-write로 공유 중인 페이지에 쓰기를 한 경우만 처리한다.
+    if(!(err & FEC_WR) || !(*pde & PTE_COW) || !(*pde & PTE_U)){
+      cprintf("Protection fault\n");
+      return -1;
+    }
+    *type = FLT_COW;
+    pa = LPTE_ADDR(*pde);
+    flags = (PTE_FLAGS(*pde) | PTE_W) & ~PTE_COW;
+    if(krefcount(P2V(pa)) == 1){
+      *pde = pa | flags;
+    } else if((mem = kalloc4m()) != 0){
+      memmove(mem, (char*)P2V(pa), LPGSIZE);
+      *pde = V2P(mem) | flags;
+      kfree4m(P2V(pa));
+    } else if(splitlarge(p->pgdir, va) < 0){
+      //새 4MB 페이지가 없으면 4KB 페이지들로 쪼개서 복사한다.
+      cprintf("Out of physical memory.\n");
+      return -1;
+    }
+    tlbinval(p->pgdir, va);
+    return 0;
+  }
+
+  pte = walkpgdir(p->pgdir, (char*)va, 0);
+
+  if(v && (pte == 0 || *pte == 0)){
+    *type = v->f ? FLT_FILE : (err & FEC_WR) ? FLT_LAZY : FLT_ZERO;
+    return vmafault(p, v, va, err & FEC_WR);
+  }
+
+  if(pte && (*pte & (PTE_P|PTE_FILE)) == PTE_FILE){
+    *type = FLT_FILE;
+    return filemap(p, va);
+  }
+
+  if(pte && (*pte & (PTE_P|PTE_SWAP)) == PTE_SWAP){
+    *type = FLT_SWAP;
+    return swapmap(p, va, *pte);
+  }
+
+  if(pte && (*pte & PTE_P) && (err & FEC_WR) && (*pte & PTE_U) && PTE_ADDR(*pte) == V2P(zeropage)){
+    //읽기만 해서 공유 zero 페이지가 매핑된 곳에 처음 쓰기를 하면 그때 새 페이지를 할당한다.
+    *pte = PTE_W | PTE_U; //다시 지연할당 상태로 돌려놓는다.
+    vmstat_add(p->pgdir, VM_ZERO, -1);
+    vmstat_add(p->pgdir, VM_LAZY, 1);
+    tlbinval(p->pgdir, va);
+    *type = FLT_LAZY;
+    return lazymap(p->pgdir, va, 1);
+  }
+
+  if(pte && (*pte & PTE_P)){
+    //이미 매핑된 페이지에서 난 폴트는 copy-on-write 페이지에 쓰기를 한 경우만 처리한다.
+    //스택 아래의 가드 페이지처럼 PTE_U가 없는 페이지는 여기서 걸러진다.
+    if(!(err & FEC_WR) || !(*pte & PTE_COW) || !(*pte & PTE_U)){
+      cprintf("Protection fault\n");
+      return -1;
+    }
+    *type = FLT_COW;
+    old = *pte;
+    pa = PTE_ADDR(old);
+    flags = (PTE_FLAGS(old) | PTE_W) & ~PTE_COW;
+    if(krefcount(P2V(pa)) == 1){
+      //공유하던 다른 프로세스가 이미 복사해 갔거나 종료했다면 복사할 필요 없이 쓰기만 허용한다.
+      *pte = pa | flags;
+    } else {
+      if((mem = uvmkalloc(0)) == 0){
+        cprintf("Out of physical memory.\n");
+        return -1;
+      }
+      //swap으로 내보내면서 잠든 사이 이 페이지가 내보내졌거나 지연 해제로 지워졌으면
+      //pa는 이미 해제되었을 수 있으므로 복사하지 않고 돌아가서 다시 폴트가 나게 한다.
+      pte = walkpgdir(p->pgdir, (char*)va, 0);
+      if(pte == 0 || *pte != old){
+        kfree(mem);
+        return 0;
+      }
+      memmove(mem, (char*)P2V(pa), PGSIZE);
+      *pte = V2P(mem) | flags;
+      kfree(P2V(pa)); //공유하던 페이지의 참조 수를 줄인다.
+    }
+    tlbinval(p->pgdir, va); //읽기 전용으로 캐시된 TLB 항목을 비운다.
+    return 0;
+  }
+
+  //지연할당된 페이지를 매핑하고, 순차 접근 중이면 뒤따르는 페이지들도 함께 매핑한다.
+  *type = (err & FEC_WR) ? FLT_LAZY : FLT_ZERO;
+  if(lazymap(p->pgdir, va, err & FEC_WR) < 0)
+    return -1;
+  faultaround(p, va, err & FEC_WR);
+  return 0;
+}
+
 int
 allocuvm_without_alloc(pde_t *pgdir, uint oldsz, uint newsz)
 {
@@ -398,8 +1202,10 @@ allocuvm_without_alloc(pde_t *pgdir, uint oldsz, uint newsz)
     for(; (uint)a < newsz; a += PGSIZE){
         if((pte = walkpgdir(pgdir, a, 1)) == 0)
             return 0;
-        if(*pte & PTE_P)
-            continue; // 이미 매핑되어 있으면 넘어감
+        if(*pte & (PTE_P|PTE_FILE|PTE_SWAP))
+            continue; // 이미 매핑되어 있거나 읽어올 내용이 있으면 넘어감
+        if(*pte == 0)
+            vmstat_add(pgdir, VM_LAZY, 1);
         // 물리 메모리를 할당하지 않고 PTE 생성
         *pte = PTE_W | PTE_U; // 쓰기 및 사용자 접근 가능 설정
         // PTE_P 플래그는 설정하지 않음
@@ -408,10 +1214,102 @@ allocuvm_without_alloc(pde_t *pgdir, uint oldsz, uint newsz)
 }
 
 
+//[va, end)를 실행 파일에서 읽어올 페이지로 표시한다. 물리 메모리는 pgfault에서 처음 접근할 때 할당한다.
+int
+fileuvm(pde_t *pgdir, uint va, uint end)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < end; a += PGSIZE){
+    if((pte = walkpgdir(pgdir, (char*)a, 1)) == 0)
+      return -1;
+    if(*pte)
+      return -1;
+    *pte = PTE_FILE | PTE_W | PTE_U;
+    vmstat_add(pgdir, VM_LAZY, 1);
+  }
+  return 0;
+}
+
+//[va, va+len)의 페이지를 커널이 폴트 없이 읽을 수 있게, write면 쓸 수도 있게 미리 매핑한다.
+//아직 읽어오지 않은 파일 페이지, swap으로 내보낸 페이지, 지연할당 페이지는 pgfault로 채우고,
+//write면 공유 zero 페이지와 copy-on-write 페이지도 여기서 새 페이지로 바꿔 둔다.
+//커널이 락을 잡은 채로 사용자 버퍼에 접근하다가 폴트에서 디스크를 기다리거나 메모리가 없어서 실패하면 안 되므로
+//argptr에서 버퍼를 넘겨주기 전에 호출한다. 쓸 수 없는 영역이거나 메모리가 없으면 -1을 반환한다.
+int
+uvmprefault(struct proc *p, uint va, uint len, int write)
+{
+  pde_t *pde;
+  pte_t *pte, e;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + len; ){
+    pde = &p->pgdir[PDX(a)];
+    if(*pde & PTE_PS)
+      e = *pde;
+    else
+      e = (pte = walkpgdir(p->pgdir, (char*)a, 0)) ? *pte : 0;
+    //PTE_W가 없는 공유 zero 페이지와 copy-on-write 페이지는 쓰기 폴트로 처리된다.
+    //pgfault가 잠든 사이 PTE가 바뀌어서 매핑하지 않고 돌아온 경우도 있으므로 같은 페이지를 다시 확인한다.
+    if((e & PTE_P) && (!write || (e & PTE_W))){
+      a += PGSIZE;
+      continue;
+    }
+    if(pgfault(p, a, write ? FEC_WR : 0) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+//커널이 사용자 주소 va에 접근하다 처리할 수 없는 폴트가 났을 때 trap에서 부른다.
+//시스템 콜 버퍼는 argptr에서 미리 매핑하므로, 여기서 매핑한 내용이 파일이나 pipe에 쓰이지는 않는다.
+//프로세스는 죽이지만 커널은 락을 잡은 채로 하던 일을 끝내야 하므로, va에 trashpage를 PTE_U 없이 매핑해서
+//같은 폴트가 반복되지 않게 한다. PTE_U가 없으므로 페이지 수에 세지 않고 swap으로 내보내지도 않는다.
+int
+killmap(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+
+  va = PGROUNDDOWN(va);
+  if(va >= KERNBASE || (pgdir[PDX(va)] & PTE_PS))
+    return -1;
+  //원래 있던 매핑(공유 zero 페이지, copy-on-write 페이지, 지연할당 PTE)은 정리해서 참조와 페이지 수를 맞춘다.
+  deallocuvm(pgdir, va + PGSIZE, va);
+  if((pte = walkpgdir(pgdir, (char*)va, 1)) == 0)
+    return -1;
+  *pte = V2P(trashpage) | PTE_W | PTE_P;
+  tlbinval(pgdir, va);
+  return 0;
+}
+
+//swap.c가 고른 페이지의 PTE를 swap slot을 가리키도록 바꾸고 원래 물리 주소를 돌려준다.
+//TLB는 호출한 쪽에서 비워야 한다.
+uint
+uvmevict(pde_t *pgdir, pte_t *pte, int slot)
+{
+  uint pa = PTE_ADDR(*pte);
+
+  *pte = (slot << PTXSHIFT) | (PTE_FLAGS(*pte) & (PTE_W|PTE_U|PTE_COW)) | PTE_SWAP;
+  vmstat_add(pgdir, VM_RSS, -1);
+  vmstat_add(pgdir, VM_SWAP, 1);
+  return pa;
+}
+
+//주소 공간의 페이지 수를 st에 채운다. 매핑이 바뀔 때마다 갱신해 둔 값을 읽기만 하므로 상수 시간이다.
+void
+vmstat(pde_t *pgdir, struct memstat *st)
+{
+  st->rss = vmstat_get(pgdir, VM_RSS);
+  st->zpages = vmstat_get(pgdir, VM_ZERO);
+  st->lazy = vmstat_get(pgdir, VM_LAZY);
+  st->swapped = vmstat_get(pgdir, VM_SWAP);
+}
+
+
 //PAGEBREAK!
 // Blank page.
 //PAGEBREAK!
 // Blank page.
 //PAGEBREAK!
 // Blank page.
-